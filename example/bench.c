@@ -0,0 +1,429 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "aparse.h"
+
+#define error aparse_prog_error
+#define info aparse_prog_info
+
+#define ARRSZ(arr) (sizeof((arr)) / sizeof((arr)[0]))
+
+#define BENCH_MAX_DEPTH 16 // APARSE__MAX_DEPTH, levels including the root
+#define BENCH_NAME_SIZE 32
+#define BENCH_VALUE_SIZE 24
+#define BENCH_PICKS 128 // options given on each generated command line
+#define BENCH_LEVEL_OPTIONS 8
+#define BENCH_ARRAY_SIZE 10000
+
+typedef enum bench_mode {
+    BENCH_TABLE,    // aparse_parse over the raw argument table
+    BENCH_COMPILED  // aparse_parse_ex over a compiled schema
+} bench_mode;
+
+// Synthetic schema, its command line, and the storage of both
+typedef struct bench_case {
+    char name[32];
+    size_t options;
+    size_t depth;
+
+    aparse_arg *args;       // every level, back to back
+    size_t arg_count;
+    char *names;            // BENCH_NAME_SIZE per argument
+    uint64_t *values;       // one destination per argument
+    aparse_list array;
+
+    char **argv;
+    int argc;
+    char *tokens;           // BENCH_VALUE_SIZE per token after argv[0]
+} bench_case;
+
+typedef struct bench_result {
+    size_t iterations;
+    double ns_per_token;
+    double allocs_per_parse;
+    double bytes_per_parse;
+    size_t peak_bytes;
+} bench_result;
+
+// argv[0] of the generated command lines, it outlives them as the program
+// name of the error and info messages
+static char g_progname[] = "aparse_bench";
+
+// Counting default allocator, peak is the highest live size during a parse
+static size_t g_allocs = 0, g_bytes = 0, g_live = 0, g_peak = 0;
+
+static void* bench_alloc(void* userdata, size_t size)
+{
+    (void)userdata;
+    g_allocs++;
+    g_bytes += size;
+    g_live += size;
+    if(g_live > g_peak)
+        g_peak = g_live;
+    return malloc(size);
+}
+
+static void* bench_realloc(void* userdata, void* ptr, size_t old_size, size_t new_size)
+{
+    (void)userdata;
+    g_allocs++;
+    if(new_size > old_size)
+        g_bytes += new_size - old_size;
+    g_live = g_live - old_size + new_size;
+    if(g_live > g_peak)
+        g_peak = g_live;
+    return realloc(ptr, new_size);
+}
+
+static void bench_free(void* userdata, void* ptr, size_t size)
+{
+    (void)userdata;
+    if(ptr)
+        g_live -= size;
+    free(ptr);
+}
+
+static const aparse_allocator bench_allocator = {
+    bench_alloc, bench_realloc, bench_free, NULL
+};
+
+static void silent_callback(
+        const aparse_context* ctx,
+        const aparse_status status,
+        const void* field1,
+        const void* field2,
+        void* userdata)
+{
+    (void)ctx;
+    (void)status;
+    (void)field1;
+    (void)field2;
+    (void)userdata;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static char* bench_token(bench_case* bc, const char* text)
+{
+    char *token = bc->tokens + (size_t)(bc->argc - 1) * BENCH_VALUE_SIZE;
+    snprintf(token, BENCH_VALUE_SIZE, "%s", text);
+    bc->argv[bc->argc++] = token;
+    return token;
+}
+
+static bool bench_reserve(bench_case* bc, const size_t args, const size_t tokens)
+{
+    bc->args = calloc(args, sizeof(aparse_arg));
+    bc->names = calloc(args, BENCH_NAME_SIZE);
+    bc->values = calloc(args, sizeof(uint64_t));
+    bc->argv = calloc(tokens + 1, sizeof(char*));
+    bc->tokens = calloc(tokens, BENCH_VALUE_SIZE);
+    if(!bc->args || !bc->names || !bc->values || !bc->argv || !bc->tokens)
+        return false;
+    bc->argv[0] = g_progname;
+    bc->argc = 1;
+    return true;
+}
+
+static void bench_release(bench_case* bc)
+{
+    free(bc->args);
+    free(bc->names);
+    free(bc->values);
+    free(bc->argv);
+    free(bc->tokens);
+    memset(bc, 0, sizeof(*bc));
+}
+
+// Option i cycles through a flag, an unsigned, a double and a string
+static aparse_arg bench_option(bench_case* bc, const size_t i, const size_t level)
+{
+    char *name = bc->names + bc->arg_count * BENCH_NAME_SIZE;
+    void *dest = &bc->values[bc->arg_count];
+    static const aparse_arg_types types[] = {
+        APARSE_ARG_TYPE_BOOL,
+        APARSE_ARG_TYPE_UNSIGNED,
+        APARSE_ARG_TYPE_FLOAT,
+        APARSE_ARG_TYPE_STRING
+    };
+    static const size_t sizes[] = { 1, sizeof(uint32_t), sizeof(double), 0 };
+
+    snprintf(name, BENCH_NAME_SIZE, "--l%u-opt%u", (unsigned)level, (unsigned)i);
+    return aparse_arg_option(NULL, name, dest, sizes[i % 4], types[i % 4], NULL);
+}
+
+// Give the option its value, split and `=` styles alternate
+static void bench_use_option(bench_case* bc, const aparse_arg* arg, const size_t i)
+{
+    static const char* values[] = { NULL, "4096", "3.25", "value" };
+    char buffer[BENCH_VALUE_SIZE];
+
+    if(!values[i % 4])
+        bench_token(bc, arg->longopt);
+    else if(i % 8 < 4)
+    {
+        bench_token(bc, arg->longopt);
+        bench_token(bc, values[i % 4]);
+    } else {
+        snprintf(buffer, sizeof(buffer), "%s=%s", arg->longopt, values[i % 4]);
+        bench_token(bc, buffer);
+    }
+}
+
+// A flat schema of `options` options, BENCH_PICKS distinct ones are given
+static bool bench_flat(bench_case* bc, const size_t options)
+{
+    const size_t picks = options < BENCH_PICKS ? options : BENCH_PICKS;
+
+    snprintf(bc->name, sizeof(bc->name), "options-%zu", options);
+    bc->options = options;
+    bc->depth = 1;
+    if(!bench_reserve(bc, options + 1, picks * 2))
+        return false;
+    for(size_t i = 0; i < options; i++)
+    {
+        bc->args[i] = bench_option(bc, i, 0);
+        bc->arg_count++;
+    }
+    // 7919 is prime, the picks never repeat an option
+    for(size_t k = 0; k < picks; k++)
+    {
+        size_t i = (k * 7919) % options;
+        bench_use_option(bc, &bc->args[i], i);
+    }
+    return true;
+}
+
+// A chain of `depth` levels, each with a few options and the next subcommand
+static bool bench_nested(bench_case* bc, const size_t depth)
+{
+    // Per level: options, the parser, its end marker, the subcommand and its end marker
+    const size_t per_level = BENCH_LEVEL_OPTIONS + 4;
+
+    snprintf(bc->name, sizeof(bc->name), "nesting-%zu", depth);
+    bc->options = depth * BENCH_LEVEL_OPTIONS;
+    bc->depth = depth;
+    if(!bench_reserve(bc, depth * per_level, depth * (BENCH_LEVEL_OPTIONS * 2 + 1)))
+        return false;
+    for(size_t level = 0; level < depth; level++)
+    {
+        aparse_arg *args = bc->args + level * per_level;
+        aparse_arg *subcommands = args + BENCH_LEVEL_OPTIONS + 2;
+        char *name = bc->names + (level * per_level + BENCH_LEVEL_OPTIONS) * BENCH_NAME_SIZE;
+
+        bc->arg_count = level * per_level;
+        for(size_t i = 0; i < BENCH_LEVEL_OPTIONS; i++)
+        {
+            args[i] = bench_option(bc, i, level);
+            bc->arg_count++;
+            bench_use_option(bc, &args[i], i);
+        }
+        if(level + 1 == depth)
+            break;
+        snprintf(name, BENCH_NAME_SIZE, "level%zu", level + 1);
+        args[BENCH_LEVEL_OPTIONS] = aparse_arg_parser("next", subcommands);
+        subcommands[0] = (aparse_arg){
+            .longopt = name,
+            .subargs = bc->args + (level + 1) * per_level,
+            .type = APARSE_ARG_TYPE_POSITIONAL
+        };
+        bench_token(bc, name);
+    }
+    return true;
+}
+
+// A single array of BENCH_ARRAY_SIZE elements of the given type
+static bool bench_array(bench_case* bc, const aparse_arg_types type, const char* label)
+{
+    const size_t size = type == APARSE_ARG_TYPE_STRING ? 0 :
+        (type == APARSE_ARG_TYPE_FLOAT ? sizeof(double) : sizeof(uint32_t));
+    char buffer[BENCH_VALUE_SIZE];
+
+    snprintf(bc->name, sizeof(bc->name), "array-%s", label);
+    bc->options = 1;
+    bc->depth = 1;
+    if(!bench_reserve(bc, 2, BENCH_ARRAY_SIZE))
+        return false;
+    bc->args[0] = aparse_arg_array("values", &bc->array, sizeof(bc->array), 0,
+            type, size, NULL);
+    bc->arg_count = 1;
+    for(size_t i = 0; i < BENCH_ARRAY_SIZE; i++)
+    {
+        if(type == APARSE_ARG_TYPE_FLOAT)
+            snprintf(buffer, sizeof(buffer), "%zu.%03zu", i * 31, i % 1000);
+        else
+            snprintf(buffer, sizeof(buffer), "%zu", i * 104729 % 4000000000u);
+        bench_token(bc, buffer);
+    }
+    return true;
+}
+
+static aparse_status bench_parse(bench_case* bc, aparse_parser* parser)
+{
+    aparse_status status = parser ?
+        aparse_parse_ex(parser, bc->argc, bc->argv, NULL) :
+        aparse_parse(bc->argc, bc->argv, bc->args, NULL, NULL);
+    aparse_list_free(&bc->array);
+    return status;
+}
+
+// Parse repeatedly for at least time_ms, doubling the batch each round
+static bool bench_run(
+        bench_case* bc,
+        const bench_mode mode,
+        const unsigned time_ms,
+        bench_result* result)
+{
+    aparse_schema *schema = NULL;
+    aparse_parser *parser = NULL;
+    double elapsed = 0;
+    size_t batch = 1, allocs = 0, bytes = 0;
+
+    memset(result, 0, sizeof(*result));
+    if(mode == BENCH_COMPILED)
+    {
+        schema = aparse_compile(bc->args);
+        parser = schema ? aparse_parser_new(schema, NULL) : NULL;
+        if(!parser)
+        {
+            aparse_schema_free(schema);
+            return false;
+        }
+        aparse_parser_set_error_callback(parser, silent_callback, NULL);
+    }
+
+    // One parse on its own, for the allocation counters and to check it succeeds
+    g_allocs = g_bytes = 0;
+    g_peak = g_live;
+    if(bench_parse(bc, parser) != APARSE_STATUS_OK)
+    {
+        aparse_parser_free(parser);
+        aparse_schema_free(schema);
+        return false;
+    }
+    allocs = g_allocs;
+    bytes = g_bytes;
+    result->peak_bytes = g_peak - g_live;
+
+    while(elapsed < (double)time_ms * 1e6)
+    {
+        double start = now_ns();
+        for(size_t i = 0; i < batch; i++)
+            bench_parse(bc, parser);
+        elapsed += now_ns() - start;
+        result->iterations += batch;
+        batch *= 2;
+    }
+    result->ns_per_token = elapsed /
+        ((double)result->iterations * (double)(bc->argc - 1));
+    result->allocs_per_parse = (double)allocs;
+    result->bytes_per_parse = (double)bytes;
+
+    aparse_parser_free(parser);
+    aparse_schema_free(schema);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned time_ms = 200;
+    const char* filter = NULL;
+    const char* output = NULL;
+    FILE* out = stdout;
+    aparse_arg main_args[] = {
+        aparse_arg_option("-t", "--time", &time_ms, sizeof(time_ms),
+                APARSE_ARG_TYPE_UNSIGNED, "Minimum time per scenario, in milliseconds"),
+        aparse_arg_option("-f", "--filter", &filter, 0,
+                APARSE_ARG_TYPE_STRING, "Only run scenarios whose name contains this"),
+        aparse_arg_option("-o", "--output", &output, 0,
+                APARSE_ARG_TYPE_STRING, "Write the results to this file"),
+        aparse_arg_end_marker
+    };
+    static const size_t option_counts[] = { 10, 100, 1000, 10000 };
+    static const size_t depths[] = { 1, 4, 8, BENCH_MAX_DEPTH };
+    static const struct { aparse_arg_types type; const char* label; } arrays[] = {
+        { APARSE_ARG_TYPE_UNSIGNED, "unsigned" },
+        { APARSE_ARG_TYPE_FLOAT, "float" },
+        { APARSE_ARG_TYPE_STRING, "string" }
+    };
+    const size_t scenarios = ARRSZ(option_counts) + ARRSZ(depths) + ARRSZ(arrays);
+    int failed = 0;
+
+    if(aparse_parse(argc, argv, main_args, 0,
+                "Benchmark of aparse parse throughput and memory use") != APARSE_STATUS_OK)
+        return 1;
+    if(output && !(out = fopen(output, "w")))
+    {
+        error("cannot open \"%s\" for writing", output);
+        return 1;
+    }
+
+    aparse_set_allocator(&bench_allocator);
+    aparse_set_error_callback(silent_callback, NULL);
+    fprintf(out, "scenario,mode,options,depth,tokens,iterations,"
+            "ns_per_token,allocs_per_parse,bytes_per_parse,peak_bytes\n");
+    for(size_t s = 0; s < scenarios; s++)
+    {
+        bench_case bc = {0};
+        bool built = false;
+        size_t index = s;
+
+        if(index < ARRSZ(option_counts))
+            built = bench_flat(&bc, option_counts[index]);
+        else if((index -= ARRSZ(option_counts)) < ARRSZ(depths))
+            built = bench_nested(&bc, depths[index]);
+        else
+        {
+            index -= ARRSZ(depths);
+            built = bench_array(&bc, arrays[index].type, arrays[index].label);
+        }
+        if(!built)
+        {
+            error("failed to allocate scenario %zu", s);
+            bench_release(&bc);
+            failed++;
+            continue;
+        }
+        if(filter && !strstr(bc.name, filter))
+        {
+            bench_release(&bc);
+            continue;
+        }
+
+        for(int mode = BENCH_TABLE; mode <= BENCH_COMPILED; mode++)
+        {
+            bench_result result;
+            const char *mode_name = mode == BENCH_TABLE ? "table" : "compiled";
+            if(!bench_run(&bc, (bench_mode)mode, time_ms, &result))
+            {
+                error("scenario %s (%s) failed to parse", bc.name, mode_name);
+                failed++;
+                continue;
+            }
+            fprintf(out, "%s,%s,%zu,%zu,%d,%zu,%.2f,%.1f,%.1f,%zu\n",
+                    bc.name, mode_name, bc.options, bc.depth, bc.argc - 1,
+                    result.iterations, result.ns_per_token,
+                    result.allocs_per_parse, result.bytes_per_parse,
+                    result.peak_bytes);
+            fflush(out);
+        }
+        bench_release(&bc);
+    }
+    aparse_set_error_callback(NULL, NULL);
+    aparse_set_allocator(NULL);
+
+    if(out != stdout)
+    {
+        fclose(out);
+        info("results written to %s", output);
+    }
+    return failed ? 1 : 0;
+}
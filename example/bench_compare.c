@@ -0,0 +1,702 @@
+// Same command lines parsed by getopt_long, argp and aparse, glibc only
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+
+#include <getopt.h>
+#include <argp.h>
+
+#include "aparse.h"
+
+#define error aparse_prog_error
+#define info aparse_prog_info
+
+#define ARRSZ(arr) (sizeof((arr)) / sizeof((arr)[0]))
+
+#define COMPARE_FLAGS 26
+#define COMPARE_VALUES 32
+#define COMPARE_ARRAY 10000
+#define COMPARE_COMMANDS 8
+#define COMPARE_KEY_BASE 256 // argp and getopt keys of long-only options
+
+// What a parse extracted, every parser must agree
+typedef struct compare_out {
+    uint32_t flags;     // one bit per flag given
+    uint64_t sum;       // sum of the numeric values
+    size_t count;       // number of values
+    int command;        // subcommand index, -1 if none
+} compare_out;
+
+typedef struct compare_scenario {
+    const char* name;
+    int argc;
+    char** argv;
+    const aparse_arg* args;
+    aparse_parser* parser;
+    bool (*run_getopt)(int argc, char** argv, compare_out* out);
+    bool (*run_argp)(int argc, char** argv, compare_out* out);
+    void (*fold)(compare_out* out); // aparse destinations into out, then cleared
+} compare_scenario;
+
+typedef enum compare_parser {
+    COMPARE_GETOPT,
+    COMPARE_ARGP,
+    COMPARE_APARSE,
+    COMPARE_APARSE_COMPILED
+} compare_parser;
+
+static const char* compare_parser_names[] = {
+    "getopt_long", "argp", "aparse", "aparse_compiled"
+};
+
+// Every allocation of the process is counted, the three parsers go
+// through malloc alike
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static size_t g_allocs = 0, g_bytes = 0;
+
+void* malloc(size_t size)
+{
+    g_allocs++;
+    g_bytes += size;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    g_allocs++;
+    g_bytes += count * size;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    g_allocs++;
+    g_bytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr)
+{
+    __libc_free(ptr);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static bool parse_u32(const char* str, uint32_t* value)
+{
+    char *end = NULL;
+    unsigned long result = 0;
+
+    errno = 0;
+    result = strtoul(str, &end, 0);
+    if(errno || end == str || *end || result > UINT32_MAX)
+        return false;
+    *value = (uint32_t)result;
+    return true;
+}
+
+// --------------------------------------- FLAGS ---------------------------------------
+// -a, --flag-b, -c, ... every letter once, alternating short and long
+
+static int g_flag_values[COMPARE_FLAGS];
+static char g_flag_names[COMPARE_FLAGS][12]; // "--flag-a", getopt and argp skip the dashes
+static char g_flag_shorts[COMPARE_FLAGS][3];
+static struct option g_flag_longopts[COMPARE_FLAGS + 1];
+static struct argp_option g_flag_argp_options[COMPARE_FLAGS + 1];
+static aparse_arg g_flag_args[COMPARE_FLAGS + 1];
+
+static bool flags_getopt(int argc, char** argv, compare_out* out)
+{
+    int key = 0;
+    optind = 0;
+    while((key = getopt_long(argc, argv, "+abcdefghijklmnopqrstuvwxyz",
+                    g_flag_longopts, NULL)) != -1)
+    {
+        if(key < 'a' || key > 'z')
+            return false;
+        out->flags |= 1u << (key - 'a');
+    }
+    return optind == argc;
+}
+
+static error_t flags_argp_parser(int key, char* arg, struct argp_state* state)
+{
+    compare_out *out = state->input;
+    (void)arg;
+    if(key >= 'a' && key <= 'z')
+    {
+        out->flags |= 1u << (key - 'a');
+        return 0;
+    }
+    return key == ARGP_KEY_ARG ? EINVAL : ARGP_ERR_UNKNOWN;
+}
+
+static bool flags_argp(int argc, char** argv, compare_out* out)
+{
+    static const struct argp argp = { g_flag_argp_options, flags_argp_parser, 0, 0, 0, 0, 0 };
+    return argp_parse(&argp, argc, argv, ARGP_SILENT, NULL, out) == 0;
+}
+
+static void flags_fold(compare_out* out)
+{
+    for(size_t i = 0; i < COMPARE_FLAGS; i++)
+    {
+        if(g_flag_values[i])
+            out->flags |= 1u << i;
+    }
+    memset(g_flag_values, 0, sizeof(g_flag_values));
+}
+
+static void flags_setup(compare_scenario* sc, char** argv)
+{
+    for(int i = 0; i < COMPARE_FLAGS; i++)
+    {
+        snprintf(g_flag_names[i], sizeof(g_flag_names[i]), "--flag-%c", 'a' + i);
+        snprintf(g_flag_shorts[i], sizeof(g_flag_shorts[i]), "-%c", 'a' + i);
+        g_flag_longopts[i] = (struct option){ g_flag_names[i] + 2, no_argument, NULL, 'a' + i };
+        g_flag_argp_options[i] = (struct argp_option){ g_flag_names[i] + 2, 'a' + i, 0, 0, 0, 0 };
+        g_flag_args[i] = aparse_arg_option(g_flag_shorts[i], g_flag_names[i],
+                &g_flag_values[i], sizeof(int), APARSE_ARG_TYPE_BOOL, NULL);
+    }
+    sc->argc = 1;
+    for(int i = 0; i < COMPARE_FLAGS; i++)
+        argv[sc->argc++] = i % 2 ? g_flag_names[i] : g_flag_shorts[i];
+    sc->args = g_flag_args;
+    sc->run_getopt = flags_getopt;
+    sc->run_argp = flags_argp;
+    sc->fold = flags_fold;
+}
+
+// --------------------------------------- VALUES ---------------------------------------
+// --val0 N, --val1=N, ... every option once, alternating split and `=` values
+
+static uint32_t g_value_values[COMPARE_VALUES];
+static char g_value_names[COMPARE_VALUES][sizeof("--val-2147483648")]; // any int fits
+static char g_value_tokens[COMPARE_VALUES][32];
+static struct option g_value_longopts[COMPARE_VALUES + 1];
+static struct argp_option g_value_argp_options[COMPARE_VALUES + 1];
+static aparse_arg g_value_args[COMPARE_VALUES + 1];
+
+static bool values_store(const int key, const char* arg, compare_out* out)
+{
+    uint32_t value = 0;
+    if(key < COMPARE_KEY_BASE || key >= COMPARE_KEY_BASE + COMPARE_VALUES ||
+            !parse_u32(arg, &value))
+        return false;
+    out->sum += value;
+    out->count++;
+    return true;
+}
+
+static bool values_getopt(int argc, char** argv, compare_out* out)
+{
+    int key = 0;
+    optind = 0;
+    while((key = getopt_long(argc, argv, "+", g_value_longopts, NULL)) != -1)
+    {
+        if(!values_store(key, optarg, out))
+            return false;
+    }
+    return optind == argc;
+}
+
+static error_t values_argp_parser(int key, char* arg, struct argp_state* state)
+{
+    if(key >= COMPARE_KEY_BASE && key < COMPARE_KEY_BASE + COMPARE_VALUES)
+        return values_store(key, arg, state->input) ? 0 : EINVAL;
+    return key == ARGP_KEY_ARG ? EINVAL : ARGP_ERR_UNKNOWN;
+}
+
+static bool values_argp(int argc, char** argv, compare_out* out)
+{
+    static const struct argp argp = { g_value_argp_options, values_argp_parser, 0, 0, 0, 0, 0 };
+    return argp_parse(&argp, argc, argv, ARGP_SILENT, NULL, out) == 0;
+}
+
+static void values_fold(compare_out* out)
+{
+    for(size_t i = 0; i < COMPARE_VALUES; i++)
+    {
+        out->sum += g_value_values[i];
+        out->count++;
+    }
+    memset(g_value_values, 0, sizeof(g_value_values));
+}
+
+static void values_setup(compare_scenario* sc, char** argv)
+{
+    for(int i = 0; i < COMPARE_VALUES; i++)
+    {
+        snprintf(g_value_names[i], sizeof(g_value_names[i]), "--val%d", i);
+        g_value_longopts[i] = (struct option){
+            g_value_names[i] + 2, required_argument, NULL, COMPARE_KEY_BASE + i
+        };
+        g_value_argp_options[i] = (struct argp_option){
+            g_value_names[i] + 2, COMPARE_KEY_BASE + i, "N", 0, 0, 0
+        };
+        g_value_args[i] = aparse_arg_option(NULL, g_value_names[i],
+                &g_value_values[i], sizeof(uint32_t), APARSE_ARG_TYPE_UNSIGNED, NULL);
+    }
+    sc->argc = 1;
+    for(int i = 0; i < COMPARE_VALUES; i++)
+    {
+        if(i % 2)
+        {
+            snprintf(g_value_tokens[i], sizeof(g_value_tokens[i]), "--val%d=%d",
+                    i, 1000 + i * 37);
+            argv[sc->argc++] = g_value_tokens[i];
+        } else {
+            snprintf(g_value_tokens[i], sizeof(g_value_tokens[i]), "%d", 1000 + i * 37);
+            argv[sc->argc++] = g_value_names[i];
+            argv[sc->argc++] = g_value_tokens[i];
+        }
+    }
+    sc->args = g_value_args;
+    sc->run_getopt = values_getopt;
+    sc->run_argp = values_argp;
+    sc->fold = values_fold;
+}
+
+// --------------------------------------- ARRAY ---------------------------------------
+// COMPARE_ARRAY positional numbers, stored into an allocated array by all parsers
+
+static aparse_list g_array_list;
+static char g_array_tokens[COMPARE_ARRAY][12];
+static aparse_arg g_array_args[2];
+
+typedef struct {
+    compare_out *out;
+    uint32_t *values;
+} array_argp_input;
+
+static bool array_getopt(int argc, char** argv, compare_out* out)
+{
+    uint32_t *values = NULL;
+    static const struct option none[] = { {0} };
+    optind = 0;
+    if(getopt_long(argc, argv, "+", none, NULL) != -1)
+        return false;
+    values = malloc((size_t)(argc - optind) * sizeof(uint32_t));
+    if(!values)
+        return false;
+    for(int i = optind; i < argc; i++)
+    {
+        if(!parse_u32(argv[i], &values[out->count]))
+        {
+            free(values);
+            return false;
+        }
+        out->sum += values[out->count++];
+    }
+    free(values);
+    return true;
+}
+
+static error_t array_argp_parser(int key, char* arg, struct argp_state* state)
+{
+    array_argp_input *input = state->input;
+    switch(key)
+    {
+        case ARGP_KEY_INIT:
+            input->values = malloc((size_t)state->argc * sizeof(uint32_t));
+            return input->values ? 0 : ENOMEM;
+        case ARGP_KEY_ARG:
+            if(!parse_u32(arg, &input->values[input->out->count]))
+                return EINVAL;
+            input->out->sum += input->values[input->out->count++];
+            return 0;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+}
+
+static bool array_argp(int argc, char** argv, compare_out* out)
+{
+    static const struct argp_option none[] = { {0} };
+    static const struct argp argp = { none, array_argp_parser, 0, 0, 0, 0, 0 };
+    array_argp_input input = { out, NULL };
+    bool ok = argp_parse(&argp, argc, argv, ARGP_SILENT, NULL, &input) == 0;
+    free(input.values);
+    return ok;
+}
+
+static void array_fold(compare_out* out)
+{
+    for(size_t i = 0; i < g_array_list.size; i++)
+    {
+        out->sum += aparse_list_get(&g_array_list, uint32_t, i);
+        out->count++;
+    }
+    aparse_list_free(&g_array_list);
+}
+
+static void array_setup(compare_scenario* sc, char** argv)
+{
+    g_array_args[0] = aparse_arg_array("values", &g_array_list, sizeof(g_array_list),
+            0, APARSE_ARG_TYPE_UNSIGNED, sizeof(uint32_t), NULL);
+    sc->argc = 1;
+    for(int i = 0; i < COMPARE_ARRAY; i++)
+    {
+        snprintf(g_array_tokens[i], sizeof(g_array_tokens[i]), "%u",
+                (unsigned)i * 104729u % 4000000000u);
+        argv[sc->argc++] = g_array_tokens[i];
+    }
+    sc->args = g_array_args;
+    sc->run_getopt = array_getopt;
+    sc->run_argp = array_argp;
+    sc->fold = array_fold;
+}
+
+// --------------------------------------- SUBCOMMANDS ---------------------------------------
+// --verbose cmd5 --alpha N --beta=N --name S --force, out of COMPARE_COMMANDS commands
+
+static int g_sub_verbose, g_sub_force, g_sub_command = -1;
+static uint32_t g_sub_alpha, g_sub_beta;
+static const char* g_sub_name;
+static char g_sub_command_names[COMPARE_COMMANDS][sizeof("cmd-2147483648")]; // any int fits
+static aparse_arg g_sub_commands[COMPARE_COMMANDS + 1];
+static aparse_arg g_sub_args[3];
+
+static const struct option g_sub_root_longopts[] = {
+    { "verbose", no_argument, NULL, 'v' }, { 0 }
+};
+static const struct option g_sub_longopts[] = {
+    { "alpha", required_argument, NULL, 'a' },
+    { "beta", required_argument, NULL, 'b' },
+    { "name", required_argument, NULL, 'n' },
+    { "force", no_argument, NULL, 'f' },
+    { 0 }
+};
+static const struct argp_option g_sub_root_argp_options[] = {
+    { "verbose", 'v', 0, 0, 0, 0 }, { 0 }
+};
+static const struct argp_option g_sub_argp_options[] = {
+    { "alpha", 'a', "N", 0, 0, 0 },
+    { "beta", 'b', "N", 0, 0, 0 },
+    { "name", 'n', "S", 0, 0, 0 },
+    { "force", 'f', 0, 0, 0, 0 },
+    { 0 }
+};
+
+static int sub_find(const char* name)
+{
+    for(int i = 0; i < COMPARE_COMMANDS; i++)
+    {
+        if(!strcmp(g_sub_command_names[i], name))
+            return i;
+    }
+    return -1;
+}
+
+// Shared by getopt_long and argp, the subcommand options
+static bool sub_store(const int key, const char* arg, compare_out* out)
+{
+    uint32_t value = 0;
+    switch(key)
+    {
+        case 'v': out->flags |= 1u; return true;
+        case 'f': out->flags |= 2u; return true;
+        case 'n': out->count += strlen(arg); return true;
+        case 'a':
+        case 'b':
+            if(!parse_u32(arg, &value))
+                return false;
+            out->sum += value;
+            return true;
+        default: return false;
+    }
+}
+
+static bool sub_getopt(int argc, char** argv, compare_out* out)
+{
+    int key = 0, command = 0;
+    optind = 0;
+    while((key = getopt_long(argc, argv, "+", g_sub_root_longopts, NULL)) != -1)
+    {
+        if(!sub_store(key, optarg, out))
+            return false;
+    }
+    if(optind >= argc || (out->command = sub_find(argv[optind])) < 0)
+        return false;
+
+    command = optind;
+    optind = 0;
+    while((key = getopt_long(argc - command, argv + command, "+",
+                    g_sub_longopts, NULL)) != -1)
+    {
+        if(!sub_store(key, optarg, out))
+            return false;
+    }
+    return optind == argc - command;
+}
+
+static error_t sub_argp_command(int key, char* arg, struct argp_state* state)
+{
+    if(key == 'a' || key == 'b' || key == 'n' || key == 'f')
+        return sub_store(key, arg, state->input) ? 0 : EINVAL;
+    return key == ARGP_KEY_ARG ? EINVAL : ARGP_ERR_UNKNOWN;
+}
+
+static error_t sub_argp_root(int key, char* arg, struct argp_state* state)
+{
+    static const struct argp command = { g_sub_argp_options, sub_argp_command, 0, 0, 0, 0, 0 };
+    compare_out *out = state->input;
+    switch(key)
+    {
+        case 'v':
+            return sub_store(key, arg, out) ? 0 : EINVAL;
+        case ARGP_KEY_ARG:
+            // The rest of the command line belongs to the subcommand
+            if((out->command = sub_find(arg)) < 0)
+                return EINVAL;
+            if(argp_parse(&command, state->argc - state->next + 1,
+                        state->argv + state->next - 1, ARGP_SILENT, NULL, out))
+                return EINVAL;
+            state->next = state->argc;
+            return 0;
+        case ARGP_KEY_NO_ARGS:
+            return EINVAL;
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+}
+
+static bool sub_argp(int argc, char** argv, compare_out* out)
+{
+    static const struct argp argp = { g_sub_root_argp_options, sub_argp_root, 0, 0, 0, 0, 0 };
+    return argp_parse(&argp, argc, argv, ARGP_SILENT | ARGP_IN_ORDER, NULL, out) == 0;
+}
+
+static void sub_command(const aparse_arg* arg, void* data)
+{
+    (void)data;
+    g_sub_command = (int)(arg - g_sub_commands);
+}
+
+static void sub_fold(compare_out* out)
+{
+    out->flags |= (g_sub_verbose ? 1u : 0u) | (g_sub_force ? 2u : 0u);
+    out->sum += (uint64_t)g_sub_alpha + g_sub_beta;
+    out->count += g_sub_name ? strlen(g_sub_name) : 0;
+    out->command = g_sub_command;
+    g_sub_verbose = g_sub_force = 0;
+    g_sub_alpha = g_sub_beta = 0;
+    g_sub_name = NULL;
+    g_sub_command = -1;
+}
+
+static void sub_setup(compare_scenario* sc, char** argv)
+{
+    static aparse_arg command_args[5];
+    static char tokens[][16] = {
+        "--verbose", "cmd5", "--alpha", "1200", "--beta=3400", "--name", "target", "--force"
+    };
+
+    command_args[0] = aparse_arg_option(NULL, "--alpha", &g_sub_alpha, sizeof(uint32_t),
+            APARSE_ARG_TYPE_UNSIGNED, NULL);
+    command_args[1] = aparse_arg_option(NULL, "--beta", &g_sub_beta, sizeof(uint32_t),
+            APARSE_ARG_TYPE_UNSIGNED, NULL);
+    command_args[2] = aparse_arg_option(NULL, "--name", &g_sub_name, 0,
+            APARSE_ARG_TYPE_STRING, NULL);
+    command_args[3] = aparse_arg_option(NULL, "--force", &g_sub_force, sizeof(int),
+            APARSE_ARG_TYPE_BOOL, NULL);
+    for(int i = 0; i < COMPARE_COMMANDS; i++)
+    {
+        snprintf(g_sub_command_names[i], sizeof(g_sub_command_names[i]), "cmd%d", i);
+        g_sub_commands[i] = (aparse_arg){
+            .longopt = g_sub_command_names[i],
+            .subargs = command_args,
+            .handler = sub_command,
+            .type = APARSE_ARG_TYPE_POSITIONAL
+        };
+    }
+    g_sub_args[0] = aparse_arg_option("-v", "--verbose", &g_sub_verbose, sizeof(int),
+            APARSE_ARG_TYPE_BOOL, NULL);
+    g_sub_args[1] = aparse_arg_parser("command", g_sub_commands);
+
+    sc->argc = 1;
+    for(size_t i = 0; i < ARRSZ(tokens); i++)
+        argv[sc->argc++] = tokens[i];
+    sc->args = g_sub_args;
+    sc->run_getopt = sub_getopt;
+    sc->run_argp = sub_argp;
+    sc->fold = sub_fold;
+}
+
+// --------------------------------------- DRIVER ---------------------------------------
+
+static bool compare_parse(
+        compare_scenario* sc,
+        const compare_parser parser,
+        compare_out* out)
+{
+    bool ok = false;
+    *out = (compare_out){ .command = -1 };
+    switch(parser)
+    {
+        case COMPARE_GETOPT:
+            return sc->run_getopt(sc->argc, sc->argv, out);
+        case COMPARE_ARGP:
+            return sc->run_argp(sc->argc, sc->argv, out);
+        case COMPARE_APARSE:
+            ok = aparse_parse(sc->argc, sc->argv, sc->args, NULL, NULL) == APARSE_STATUS_OK;
+            break;
+        case COMPARE_APARSE_COMPILED:
+            ok = aparse_parse_ex(sc->parser, sc->argc, sc->argv, NULL) == APARSE_STATUS_OK;
+            break;
+    }
+    sc->fold(out);
+    return ok;
+}
+
+static void silent_callback(
+        const aparse_context* ctx,
+        const aparse_status status,
+        const void* field1,
+        const void* field2,
+        void* userdata)
+{
+    (void)ctx;
+    (void)status;
+    (void)field1;
+    (void)field2;
+    (void)userdata;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned time_ms = 200;
+    const char* filter = NULL;
+    const char* output = NULL;
+    FILE* out = stdout;
+    aparse_arg main_args[] = {
+        aparse_arg_option("-t", "--time", &time_ms, sizeof(time_ms),
+                APARSE_ARG_TYPE_UNSIGNED, "Minimum time per parser and scenario, in milliseconds"),
+        aparse_arg_option("-f", "--filter", &filter, 0,
+                APARSE_ARG_TYPE_STRING, "Only run scenarios whose name contains this"),
+        aparse_arg_option("-o", "--output", &output, 0,
+                APARSE_ARG_TYPE_STRING, "Write the results to this file"),
+        aparse_arg_end_marker
+    };
+    static const struct {
+        const char* name;
+        void (*setup)(compare_scenario* sc, char** argv);
+    } scenarios[] = {
+        { "flags", flags_setup },
+        { "values", values_setup },
+        { "array", array_setup },
+        { "subcommands", sub_setup }
+    };
+    static char* scenario_argv[COMPARE_ARRAY + 2];
+    static char progname[] = "aparse_bench_compare";
+    int failed = 0;
+
+    if(aparse_parse(argc, argv, main_args, 0,
+                "Parse the same command lines with getopt_long, argp and aparse") != APARSE_STATUS_OK)
+        return 1;
+    if(output && !(out = fopen(output, "w")))
+    {
+        error("cannot open \"%s\" for writing", output);
+        return 1;
+    }
+
+    opterr = 0;
+    aparse_set_error_callback(silent_callback, NULL);
+    fprintf(out, "scenario,parser,tokens,iterations,ns_per_parse,ns_per_token,"
+            "parses_per_sec,allocs_per_parse,bytes_per_parse\n");
+    for(size_t s = 0; s < ARRSZ(scenarios); s++)
+    {
+        compare_scenario sc = { .name = scenarios[s].name, .argv = scenario_argv };
+        aparse_schema *schema = NULL;
+        compare_out expected = {0};
+        bool has_expected = false; // the getopt_long baseline parsed
+
+        if(filter && !strstr(sc.name, filter))
+            continue;
+        scenario_argv[0] = progname;
+        scenarios[s].setup(&sc, scenario_argv);
+        scenario_argv[sc.argc] = NULL;
+        schema = aparse_compile(sc.args);
+        sc.parser = schema ? aparse_parser_new(schema, NULL) : NULL;
+        if(!sc.parser)
+        {
+            error("failed to compile scenario %s", sc.name);
+            aparse_schema_free(schema);
+            failed++;
+            continue;
+        }
+        aparse_parser_set_error_callback(sc.parser, silent_callback, NULL);
+
+        for(int p = COMPARE_GETOPT; p <= COMPARE_APARSE_COMPILED; p++)
+        {
+            const compare_parser parser = (compare_parser)p;
+            compare_out result;
+            size_t iterations = 0, batch = 1, allocs = 0, bytes = 0;
+            double elapsed = 0;
+
+            // One parse on its own, for the allocation counters and the checks
+            g_allocs = g_bytes = 0;
+            if(!compare_parse(&sc, parser, &result))
+            {
+                error("%s failed to parse scenario %s", compare_parser_names[p], sc.name);
+                failed++;
+                continue;
+            }
+            allocs = g_allocs;
+            bytes = g_bytes;
+            if(parser == COMPARE_GETOPT)
+            {
+                expected = result;
+                has_expected = true;
+            }
+            else if(has_expected && 
+                    (result.flags != expected.flags || result.sum != expected.sum ||
+                    result.count != expected.count || result.command != expected.command))
+            {
+                error("%s disagrees with getopt_long on scenario %s",
+                        compare_parser_names[p], sc.name);
+                failed++;
+                continue;
+            }
+
+            while(elapsed < (double)time_ms * 1e6)
+            {
+                double start = now_ns();
+                for(size_t i = 0; i < batch; i++)
+                    compare_parse(&sc, parser, &result);
+                elapsed += now_ns() - start;
+                iterations += batch;
+                batch *= 2;
+            }
+            fprintf(out, "%s,%s,%d,%zu,%.1f,%.2f,%.0f,%zu,%zu\n",
+                    sc.name, compare_parser_names[p], sc.argc - 1, iterations,
+                    elapsed / (double)iterations,
+                    elapsed / ((double)iterations * (double)(sc.argc - 1)),
+                    (double)iterations * 1e9 / elapsed,
+                    allocs, bytes);
+            fflush(out);
+        }
+        aparse_parser_free(sc.parser);
+        aparse_schema_free(schema);
+    }
+    aparse_set_error_callback(NULL, NULL);
+
+    if(out != stdout)
+    {
+        fclose(out);
+        info("results written to %s", output);
+    }
+    return failed ? 1 : 0;
+}
@@ -26,7 +26,7 @@ int main(int argc, char** argv) {
         aparse_arg_number(
                 "number", &number, sizeof(number), 
                 APARSE_ARG_TYPE_SIGNED, "Just a number"),
-        // array_size=0: take all argument after it. library automatically allocated memory for it
+        // array_size=0: take all argument after it, up to the next option. library automatically allocated memory for it
         // element_size=0: means the string have no size limitation
         aparse_arg_array(
                 "strings", &strings, sizeof(strings), 0, 
@@ -0,0 +1,41 @@
+#include <stdio.h>
+
+#include "static_example.h"
+#include "static_schema.h"
+
+int g_result_only = 0;
+int g_scale = 1;
+
+void add_command(const aparse_arg *arg, void *data)
+{
+    add_payload_t *p = data;
+    (void)arg;
+
+    if(!g_result_only)
+    {
+        aparse_prog_info("result: (%d + %d) * %d = %d", 
+                p->a, p->b, g_scale, (p->a + p->b) * g_scale);
+    } else {
+        aparse_prog_info("result: %d", 
+                (p->a + p->b) * g_scale);
+    }
+}
+
+void nothing_command(const aparse_arg *arg, void *data)
+{
+    (void)arg;
+    (void)data;
+    aparse_prog_info("this do nothing, seriously");
+}
+
+int main(int argc, char **argv)
+{
+    // The schema was generated from static_schema.json at build time,
+    // no index is built here
+    if(aparse_parse_schema(
+                argc, argv, 
+                &static_example_schema, NULL,
+                "Demonstration for generated schemas") != APARSE_STATUS_OK)
+        return 1;
+    return 0;
+}
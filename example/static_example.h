@@ -0,0 +1,18 @@
+#ifndef STATIC_EXAMPLE_H
+#define STATIC_EXAMPLE_H
+
+#include <aparse.h>
+
+typedef struct
+{
+    int a;
+    int b;
+} add_payload_t;
+
+extern int g_result_only;
+extern int g_scale;
+
+void add_command(const aparse_arg *arg, void *data);
+void nothing_command(const aparse_arg *arg, void *data);
+
+#endif
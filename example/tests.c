@@ -10,6 +10,7 @@
 #   include <limits.h>
 #   include <spawn.h>
 #   include <sys/wait.h>
+extern char **environ;
 #else
 #endif
 
@@ -25,11 +26,33 @@ typedef struct test_entry {
     const char* name;
     int argc;
     const char** argv;
-    aparse_arg* args;
+    const aparse_arg* args;
     aparse_status expected;
     uint32_t hash;
+    bool compiled;
+    bool reentrant; // through a no-alloc aparse_parser, arrays stay in their caller storage
+    int repeat; // parse the same table this many times (at least once)
+    unsigned threads; // reentrant parses convert every array on this many threads
+    bool response_files; // reentrant parses expand @file arguments
+    unsigned dispatch_threads; // reentrant parses dispatch on this many threads
+    const aparse_dispatch_dep* deps;
+    size_t dep_count;
 } test_entry;
 
+// Features beyond parsing argv, asserted directly instead of hashed
+typedef struct check_entry {
+    const char* name;
+    bool (*run)(void);
+} check_entry;
+
+#define CHECK(cond) \
+    do { \
+        if(!(cond)) \
+        { \
+            error("%s:%d: check failed: %s", __func__, __LINE__, #cond); \
+            return false; \
+        } \
+    } while(0)
 
 static inline uint32_t fnv1a(
         const uint8_t *data,
@@ -50,6 +73,7 @@ static const char* status_string(const aparse_status status)
         [APARSE_STATUS_OK]                  = "APARSE_STATUS_OK",
         [APARSE_STATUS_FAILURE]             = "APARSE_STATUS_FAILURE",
         [APARSE_STATUS_UNKNOWN_ARGUMENT]    = "APARSE_STATUS_UNKNOWN_ARGUMENT",
+        [APARSE_STATUS_MISSING_VALUE]       = "APARSE_STATUS_MISSING_VALUE",
         [APARSE_STATUS_INVALID_VALUE]       = "APARSE_STATUS_INVALID_VALUE",
         [APARSE_STATUS_OVERFLOW]            = "APARSE_STATUS_OVERFLOW",
         [APARSE_STATUS_UNDERFLOW]           = "APARSE_STATUS_UNDERFLOW",
@@ -58,8 +82,11 @@ static const char* status_string(const aparse_status status)
         [APARSE_STATUS_NULL_POINTER]        = "APARSE_STATUS_NULL_POINTER",
         [APARSE_STATUS_INVALID_TYPE]        = "APARSE_STATUS_INVALID_TYPE",
         [APARSE_STATUS_INVALID_SIZE]        = "APARSE_STATUS_INVALID_SIZE",
+        [APARSE_STATUS_INVALID_LAYOUT]      = "APARSE_STATUS_INVALID_LAYOUT",
         [APARSE_STATUS_ALLOC_FAILURE]       = "APARSE_STATUS_ALLOC_FAILURE",
         [APARSE_STATUS_UNHANDLED]           = "APARSE_STATUS_UNHANDLED",
+        [APARSE_STATUS_TOO_DEEP]            = "APARSE_STATUS_TOO_DEEP",
+        [APARSE_STATUS_RESPONSE_FILE]       = "APARSE_STATUS_RESPONSE_FILE",
     };
     if(status < 0 || status >= __APARSE_STATUS_ENUM_END__)
         return 0;
@@ -68,7 +95,7 @@ static const char* status_string(const aparse_status status)
 
 // Return value: the process status
 static int spawn_process(
-        const test_entry test,
+        const char* name,
         const int flag_verbose)
 {
 #ifndef APARSE_PLATFORM_WIN32
@@ -84,13 +111,15 @@ static int spawn_process(
 
     const char *argv[4] = {0};
     argv[0] = path;
-    argv[1] = test.name;
+    argv[1] = name;
     argv[2] = flag_verbose ? "--verbose" : 0;
     argv[3] = 0;
 
+    const char *empty_env[1] = {0};
     pid_t pid = -1;
     if(posix_spawn(&pid, path, NULL, NULL, 
-                (char *const *)(uintptr_t)argv, 0) == -1)
+                (char *const *)(uintptr_t)argv, 
+                (char *const *)(uintptr_t)empty_env) == -1)
     {
         error("unable to create the process: %s", 
                 strerror(errno));
@@ -109,6 +138,7 @@ static int spawn_process(
 #endif
 }
 
+static int g_verbose = 0;
 static aparse_status g_last_status = APARSE_STATUS_OK;
 static void error_callback(
         const aparse_context *ctx,
@@ -133,6 +163,679 @@ static void dummy_command(const aparse_arg *arg, void* data)
     (void)data; 
 }
 
+static size_t g_heap_calls = 0;
+static void* heap_alloc(void* userdata, size_t size)
+{
+    (void)userdata;
+    g_heap_calls++;
+    return malloc(size);
+}
+static void* heap_realloc(void* userdata, void* ptr, size_t old_size, size_t new_size)
+{
+    (void)userdata;
+    (void)old_size;
+    g_heap_calls++;
+    return realloc(ptr, new_size);
+}
+static void heap_free(void* userdata, void* ptr, size_t size)
+{
+    (void)userdata;
+    (void)size;
+    free(ptr);
+}
+static const aparse_allocator heap_allocator = {
+    heap_alloc, heap_realloc, heap_free, NULL
+};
+
+static uint8_t *g_sink = NULL;
+static void sink_command(const aparse_arg *arg, void* data) 
+{ 
+    (void)arg;
+    memcpy(g_sink, data, sizeof(copy_data));
+    g_sink += sizeof(copy_data);
+}
+
+static bool sink_values(const aparse_arg *arg, const void* values, 
+        size_t count, void* userdata)
+{
+    (void)arg;
+    memcpy(g_sink, values, count * *(const size_t*)userdata);
+    g_sink += count * *(const size_t*)userdata;
+    return true;
+}
+
+// argv ends with NULL like the one of main
+static aparse_status parse_argv(
+        aparse_parser* parser,
+        const char** argv)
+{
+    int argc = 0;
+    while(argv[argc])
+        argc++;
+    return aparse_parse_ex(parser, argc, 
+            (char *const *)(uintptr_t)argv, NULL);
+}
+
+static const char *g_lazy_argv[] = {
+    "tests", "-s", "-5", "-d", "2.5", "--bad=x", "-s", "-300", NULL
+};
+
+// The parse only matches, each getter converts on first use
+static bool check_lazy_getters(void)
+{
+    int16_t small = 0;
+    double delta = 0.0;
+    uint32_t bad = 0, unused = 0;
+    int64_t i64 = 0;
+    uint64_t u64 = 0;
+    double f64 = 0.0;
+    const aparse_arg args[] = {
+        aparse_arg_option("-s", "--small", 
+                &small, sizeof(small), APARSE_ARG_TYPE_SIGNED, 0),
+        aparse_arg_option("-d", "--delta", 
+                &delta, sizeof(delta), APARSE_ARG_TYPE_FLOAT, 0),
+        aparse_arg_option("-b", "--bad", 
+                &bad, sizeof(bad), APARSE_ARG_TYPE_UNSIGNED, 0),
+        aparse_arg_option("-u", "--unused", 
+                &unused, sizeof(unused), APARSE_ARG_TYPE_UNSIGNED, 0),
+        aparse_arg_end_marker
+    };
+    aparse_schema *schema = aparse_compile(args);
+    aparse_parser *parser = aparse_parser_new(schema, NULL);
+    CHECK(parser);
+    aparse_parser_set_error_callback(parser, error_callback, &g_verbose);
+    aparse_parser_set_lazy(parser, true);
+
+    // The bad value does not fail the parse
+    CHECK(parse_argv(parser, g_lazy_argv) == APARSE_STATUS_OK);
+    CHECK(small == 0 && delta == 0.0 && bad == 0);
+    // The table of deferred values is the only allocation
+    CHECK(aparse_parser_alloc_stats(parser).count == 1);
+
+    CHECK(aparse_get_i64(parser, &args[0], &i64) == APARSE_STATUS_OK);
+    CHECK(i64 == -300 && small == -300);
+    CHECK(aparse_get_f64(parser, &args[1], &f64) == APARSE_STATUS_OK);
+    CHECK(f64 == 2.5 && delta == 2.5);
+    // Remembered, the second read fails the same way
+    CHECK(aparse_get_u64(parser, &args[2], &u64) == APARSE_STATUS_INVALID_VALUE);
+    CHECK(aparse_get_u64(parser, &args[2], &u64) == APARSE_STATUS_INVALID_VALUE);
+    CHECK(bad == 0);
+    CHECK(aparse_get_u64(parser, &args[3], &u64) == APARSE_STATUS_OK && u64 == 0);
+    // Only numbers of the matching type
+    CHECK(aparse_get_u64(parser, &args[0], &u64) == APARSE_STATUS_INVALID_TYPE);
+
+    aparse_parser_free(parser);
+    aparse_schema_free(schema);
+    return true;
+}
+
+// The deferred values live in the arena until it is reset
+static bool check_lazy_arena(void)
+{
+    _Alignas(max_align_t) uint8_t storage[1024];
+    int16_t small = 0;
+    double delta = 0.0;
+    uint32_t bad = 0;
+    int64_t i64 = 0;
+    const aparse_arg args[] = {
+        aparse_arg_option("-s", "--small", 
+                &small, sizeof(small), APARSE_ARG_TYPE_SIGNED, 0),
+        aparse_arg_option("-d", "--delta", 
+                &delta, sizeof(delta), APARSE_ARG_TYPE_FLOAT, 0),
+        aparse_arg_option("-b", "--bad", 
+                &bad, sizeof(bad), APARSE_ARG_TYPE_UNSIGNED, 0),
+        aparse_arg_end_marker
+    };
+    aparse_arena arena;
+    aparse_schema *schema = aparse_compile(args);
+    aparse_parser *parser = aparse_parser_new(schema, NULL);
+    CHECK(parser);
+    aparse_parser_set_error_callback(parser, error_callback, &g_verbose);
+    aparse_arena_init(&arena, storage, sizeof(storage));
+    aparse_parser_set_arena(parser, &arena);
+    aparse_parser_set_lazy(parser, true);
+
+    for(int i = 0; i < 2; i++)
+    {
+        aparse_arena_reset(&arena);
+        small = 0;
+        CHECK(parse_argv(parser, g_lazy_argv) == APARSE_STATUS_OK);
+        CHECK(small == 0);
+        CHECK(aparse_get_i64(parser, &args[0], &i64) == APARSE_STATUS_OK);
+        CHECK(i64 == -300);
+    }
+
+    aparse_parser_free(parser);
+    aparse_schema_free(schema);
+    return true;
+}
+
+// Payloads and the dispatch list come from the arena, never the heap
+static bool check_arena_repeat(void)
+{
+    _Alignas(max_align_t) uint8_t storage[1024];
+    copy_data copies[3] = {0};
+    const aparse_arg subargs[] = {
+        aparse_arg_string("file", 0, 32, "Source"),
+        aparse_arg_string("dest", 0, 32, "Destionation"),
+        aparse_arg_end_marker
+    };
+    const aparse_arg commands[] = {
+        aparse_arg_subparser("copy", subargs, sink_command, 
+                NULL, 0, 0, copy_data, src, dest),
+        aparse_arg_end_marker
+    };
+    const aparse_arg args[] = {
+        aparse_arg_parser("command", commands),
+        aparse_arg_end_marker
+    };
+    const char *argv[] = {"tests", "copy", "fox", "binary", NULL};
+    aparse_arena arena;
+    aparse_schema *schema = aparse_compile(args);
+    aparse_parser *parser = aparse_parser_new(schema, NULL);
+    CHECK(parser);
+    aparse_parser_set_error_callback(parser, error_callback, &g_verbose);
+    aparse_arena_init(&arena, storage, sizeof(storage));
+    aparse_parser_set_arena(parser, &arena);
+
+    g_sink = (uint8_t*)copies;
+    aparse_set_allocator(&heap_allocator);
+    for(size_t i = 0; i < ARRSZ(copies); i++)
+    {
+        aparse_arena_reset(&arena);
+        CHECK(parse_argv(parser, argv) == APARSE_STATUS_OK);
+    }
+    aparse_set_allocator(NULL);
+    CHECK(g_heap_calls == 0);
+    for(size_t i = 0; i < ARRSZ(copies); i++)
+        CHECK(!strcmp(copies[i].src, "fox") && !strcmp(copies[i].dest, "binary"));
+
+    aparse_parser_free(parser);
+    aparse_schema_free(schema);
+    return true;
+}
+
+// Counted per parse, through the allocator of the parser
+static bool check_alloc_stats(void)
+{
+    uint32_t num = 0;
+    int flag = 0;
+    copy_data copy = {0};
+    const aparse_arg options[] = {
+        aparse_arg_option("-n", "--num", 
+                &num, sizeof(num), APARSE_ARG_TYPE_UNSIGNED, 0),
+        aparse_arg_option("-f", "--flag", 
+                &flag, sizeof(flag), APARSE_ARG_TYPE_BOOL, 0),
+        aparse_arg_end_marker
+    };
+    const aparse_arg subargs[] = {
+        aparse_arg_string("file", 0, 32, "Source"),
+        aparse_arg_string("dest", 0, 32, "Destionation"),
+        aparse_arg_end_marker
+    };
+    const aparse_arg commands[] = {
+        aparse_arg_subparser("copy", subargs, sink_command, 
+                NULL, 0, 0, copy_data, src, dest),
+        aparse_arg_end_marker
+    };
+    const aparse_arg args[] = {
+        aparse_arg_parser("command", commands),
+        aparse_arg_end_marker
+    };
+    const char *option_argv[] = {"tests", "--num=42", "-f", NULL};
+    const char *command_argv[] = {"tests", "copy", "fox", "binary", NULL};
+    aparse_alloc_stats stats;
+    aparse_schema *option_schema = aparse_compile(options);
+    aparse_schema *schema = aparse_compile(args);
+    aparse_parser *option_parser = aparse_parser_new(option_schema, NULL);
+    aparse_parser *parser = aparse_parser_new(schema, NULL);
+    CHECK(option_parser && parser);
+    aparse_parser_set_error_callback(option_parser, error_callback, &g_verbose);
+    aparse_parser_set_error_callback(parser, error_callback, &g_verbose);
+    aparse_parser_set_allocator(option_parser, &heap_allocator);
+    aparse_parser_set_allocator(parser, &heap_allocator);
+
+    stats = aparse_parser_alloc_stats(parser);
+    CHECK(stats.count == 0 && stats.bytes == 0 && stats.peak == 0);
+
+    // Options only are parsed without allocating
+    CHECK(parse_argv(option_parser, option_argv) == APARSE_STATUS_OK);
+    CHECK(num == 42 && flag);
+    stats = aparse_parser_alloc_stats(option_parser);
+    CHECK(stats.count == 0 && stats.bytes == 0 && g_heap_calls == 0);
+
+    // The payload and the dispatch list
+    g_sink = (uint8_t*)&copy;
+    CHECK(parse_argv(parser, command_argv) == APARSE_STATUS_OK);
+    CHECK(!strcmp(copy.src, "fox") && !strcmp(copy.dest, "binary"));
+    stats = aparse_parser_alloc_stats(parser);
+    CHECK(stats.count == 2 && g_heap_calls == 2);
+    CHECK(stats.bytes >= sizeof(copy_data) && 
+            stats.peak > 0 && stats.peak <= stats.bytes);
+
+    // Not cumulative
+    g_sink = (uint8_t*)&copy;
+    CHECK(parse_argv(parser, command_argv) == APARSE_STATUS_OK);
+    CHECK(aparse_parser_alloc_stats(parser).count == 2);
+
+    aparse_parser_free(option_parser);
+    aparse_parser_free(parser);
+    aparse_schema_free(option_schema);
+    aparse_schema_free(schema);
+    return true;
+}
+
+// Payloads and the slots of a wide level come from the region
+static bool check_no_alloc(void)
+{
+    _Alignas(max_align_t) uint8_t region[4096];
+    copy_data copy = {0};
+    uint32_t value = 0;
+    char names[72][8];
+    aparse_arg wide[ARRSZ(names) + 1] = {0};
+    const aparse_arg subargs[] = {
+        aparse_arg_string("file", 0, 32, "Source"),
+        aparse_arg_string("dest", 0, 32, "Destionation"),
+        aparse_arg_end_marker
+    };
+    const aparse_arg commands[] = {
+        aparse_arg_subparser("copy", subargs, sink_command, 
+                NULL, 0, 0, copy_data, src, dest),
+        aparse_arg_end_marker
+    };
+    const aparse_arg args[] = {
+        aparse_arg_parser("command", commands),
+        aparse_arg_end_marker
+    };
+    const char *command_argv[] = {"tests", "copy", "fox", "binary", NULL};
+    const char *wide_argv[] = {"tests", "--o70", "5", NULL};
+    // More options than the parser has inline slots for
+    for(size_t i = 0; i < ARRSZ(names); i++)
+    {
+        snprintf(names[i], sizeof(names[i]), "--o%zu", i);
+        wide[i] = aparse_arg_option(NULL, names[i], 
+                &value, sizeof(value), APARSE_ARG_TYPE_UNSIGNED, 0);
+    }
+    aparse_schema *schema = aparse_compile(args);
+    aparse_schema *wide_schema = aparse_compile(wide);
+    aparse_parser *parser = aparse_parser_new(schema, NULL);
+    aparse_parser *wide_parser = aparse_parser_new(wide_schema, NULL);
+    CHECK(parser && wide_parser);
+    aparse_parser_set_error_callback(parser, error_callback, &g_verbose);
+    aparse_parser_set_error_callback(wide_parser, error_callback, &g_verbose);
+    aparse_parser_set_no_alloc(parser, region, sizeof(region));
+    aparse_parser_set_no_alloc(wide_parser, region, sizeof(region));
+
+    aparse_set_allocator(&heap_allocator);
+    g_sink = (uint8_t*)&copy;
+    CHECK(parse_argv(parser, command_argv) == APARSE_STATUS_OK);
+    // Later parses must not cache what the first one wanted on the heap
+    for(int i = 0; i < 3; i++)
+    {
+        value = 0;
+        CHECK(parse_argv(wide_parser, wide_argv) == APARSE_STATUS_OK);
+        CHECK(value == 5);
+    }
+    aparse_set_allocator(NULL);
+    CHECK(g_heap_calls == 0);
+    CHECK(!strcmp(copy.src, "fox") && !strcmp(copy.dest, "binary"));
+
+    // Too small for the payload, nothing falls back to the heap
+    aparse_parser_set_no_alloc(parser, region, 16);
+    aparse_set_allocator(&heap_allocator);
+    CHECK(parse_argv(parser, command_argv) != APARSE_STATUS_OK);
+    aparse_set_allocator(NULL);
+    CHECK(g_heap_calls == 0 && g_last_status == APARSE_STATUS_ALLOC_FAILURE);
+
+    aparse_parser_free(parser);
+    aparse_parser_free(wide_parser);
+    aparse_schema_free(schema);
+    aparse_schema_free(wide_schema);
+    return true;
+}
+
+// Arrays are written into the caller's list, which keeps its capacity
+static bool check_no_alloc_array(void)
+{
+    _Alignas(max_align_t) uint8_t region[256];
+    uint32_t storage[4] = {0};
+    aparse_list nums = {
+        .ptr = storage, 
+        .capacity = ARRSZ(storage), 
+        .itemsz = sizeof(uint32_t)
+    };
+    const aparse_arg args[] = {
+        aparse_arg_array("nums", &nums, sizeof(nums), 0,
+                APARSE_ARG_TYPE_UNSIGNED, sizeof(uint32_t), 0),
+        aparse_arg_end_marker
+    };
+    const char *short_argv[] = {"tests", "1", "2", NULL};
+    const char *full_argv[] = {"tests", "4", "3", "2", "1", NULL};
+    const char *over_argv[] = {"tests", "1", "2", "3", "4", "5", NULL};
+    aparse_schema *schema = aparse_compile(args);
+    aparse_parser *parser = aparse_parser_new(schema, NULL);
+    CHECK(parser);
+    aparse_parser_set_error_callback(parser, error_callback, &g_verbose);
+    aparse_parser_set_no_alloc(parser, region, sizeof(region));
+
+    aparse_set_allocator(&heap_allocator);
+    CHECK(parse_argv(parser, short_argv) == APARSE_STATUS_OK);
+    CHECK(nums.ptr == storage && nums.size == 2 && nums.capacity == 4);
+    CHECK(storage[0] == 1 && storage[1] == 2);
+    // A shorter parse did not shrink the capacity
+    CHECK(parse_argv(parser, full_argv) == APARSE_STATUS_OK);
+    CHECK(nums.ptr == storage && nums.size == 4 && nums.capacity == 4);
+    CHECK(storage[0] == 4 && storage[3] == 1);
+    CHECK(parse_argv(parser, over_argv) != APARSE_STATUS_OK);
+    CHECK(g_last_status == APARSE_STATUS_ALLOC_FAILURE);
+    CHECK(nums.ptr == storage && nums.capacity == 4);
+    aparse_set_allocator(NULL);
+    CHECK(g_heap_calls == 0);
+
+    aparse_parser_free(parser);
+    aparse_schema_free(schema);
+    return true;
+}
+
+// Errors only end up in the results, the destinations stay untouched
+static bool check_parse_batch(void)
+{
+    uint32_t num = 0;
+    int flag = 0;
+    const aparse_arg args[] = {
+        aparse_arg_option("-n", "--num", 
+                &num, sizeof(num), APARSE_ARG_TYPE_UNSIGNED, 0),
+        aparse_arg_option("-f", "--flag", 
+                &flag, sizeof(flag), APARSE_ARG_TYPE_BOOL, 0),
+        aparse_arg_end_marker
+    };
+    // One input per error, on two threads
+    const char *argv_ok[] = {"tests", "-n", "5", "-f", NULL};
+    const char *argv_invalid[] = {"tests", "-n", "x", NULL};
+    const char *argv_unknown[] = {"tests", "--bogus", NULL};
+    const char *argv_help[] = {"tests", "-h", NULL};
+    const char *argv_missing[] = {"tests", "-n", NULL};
+    const char **inputs[] = {
+        argv_ok, argv_invalid, argv_unknown, argv_help, argv_missing
+    };
+    int argcs[ARRSZ(inputs)];
+    char* const* argvs[ARRSZ(inputs)];
+    aparse_batch_result results[ARRSZ(inputs)];
+    aparse_schema *schema = aparse_compile(args);
+    CHECK(schema);
+    for(size_t i = 0; i < ARRSZ(inputs); i++)
+    {
+        argcs[i] = 0;
+        while(inputs[i][argcs[i]])
+            argcs[i]++;
+        argvs[i] = (char *const *)(uintptr_t)inputs[i];
+    }
+
+    CHECK(aparse_parse_batch(schema, ARRSZ(inputs), 
+                argcs, argvs, 2, results) == APARSE_STATUS_FAILURE);
+    CHECK(results[0].status == APARSE_STATUS_OK && results[0].token == -1);
+    CHECK(results[1].status == APARSE_STATUS_INVALID_VALUE && results[1].token == 2);
+    CHECK(results[2].status == APARSE_STATUS_UNKNOWN_ARGUMENT && results[2].token == 1);
+    // A help request fails without printing
+    CHECK(results[3].status == APARSE_STATUS_FAILURE && results[3].token == 1);
+    CHECK(results[4].status == APARSE_STATUS_MISSING_VALUE && results[4].token == 1);
+    CHECK(num == 0 && flag == 0);
+
+    CHECK(aparse_parse_batch(schema, 1, argcs, argvs, 0, results) == APARSE_STATUS_OK);
+    CHECK(results[0].status == APARSE_STATUS_OK && num == 0);
+    CHECK(aparse_parse_batch(schema, 1, argcs, argvs, 0, NULL) == 
+            APARSE_STATUS_NULL_POINTER);
+
+    aparse_schema_free(schema);
+    return true;
+}
+
+// Views point into argv, nothing is copied
+static bool check_string_view(void)
+{
+    aparse_string_view query = {0}, path = {0};
+    const aparse_arg args[] = {
+        aparse_arg_option("-q", "--query", &query, 
+                sizeof(query), APARSE_ARG_TYPE_STRING_VIEW, 0),
+        aparse_arg_string_view("path", &path, 0),
+        aparse_arg_end_marker
+    };
+    const char *argv[] = {"tests", "--query=a=b", "some/long/path", NULL};
+    aparse_schema *schema = aparse_compile(args);
+    aparse_parser *parser = aparse_parser_new(schema, NULL);
+    CHECK(parser);
+    aparse_parser_set_error_callback(parser, error_callback, &g_verbose);
+
+    CHECK(parse_argv(parser, argv) == APARSE_STATUS_OK);
+    // The value starts past the first '='
+    CHECK(query.ptr == argv[1] + 8 && query.len == 3);
+    CHECK(path.ptr == argv[2] && path.len == strlen(argv[2]));
+
+    aparse_parser_free(parser);
+    aparse_schema_free(schema);
+    return true;
+}
+
+typedef struct env_values {
+    uint32_t num;
+    int flag;
+    double scale;
+    char name[16];
+} env_values;
+
+static aparse_status parse_env(
+        aparse_parser* parser,
+        const char** argv,
+        const char** env)
+{
+    // The spawned checks start from an empty environment
+    environ = (char**)(uintptr_t)env;
+    return parse_argv(parser, argv);
+}
+
+// argv wins over the environment, the first definition over later ones
+static bool check_env_fallback(void)
+{
+    _Alignas(max_align_t) uint8_t region[1024];
+    env_values values = {0};
+    char fillers[300][24];
+    aparse_arg args[] = {
+        aparse_arg_option("-n", "--num", &values.num, 
+                sizeof(values.num), APARSE_ARG_TYPE_UNSIGNED, 0),
+        aparse_arg_option("-f", "--flag", &values.flag, 
+                sizeof(values.flag), APARSE_ARG_TYPE_BOOL, 0),
+        aparse_arg_option("-s", "--scale", &values.scale, 
+                sizeof(values.scale), APARSE_ARG_TYPE_FLOAT, 0),
+        aparse_arg_string("name", values.name, sizeof(values.name), 0),
+        aparse_arg_end_marker
+    };
+    const char *argv[] = {"tests", "-n", "7", NULL};
+    const char *env[] = {"APARSE_TEST_NUM=99", "APARSE_TEST_FLAG=1",
+        "APARSE_TEST_NAME=from-env", "APARSE_TEST_NAME=later", 
+        "APARSE_TEST_NUMBER=5", NULL};
+    // More variables than an index over them would take of the region
+    const char *wide_env[ARRSZ(fillers) + ARRSZ(env)];
+    for(size_t i = 0; i < ARRSZ(fillers); i++)
+    {
+        snprintf(fillers[i], sizeof(fillers[i]), "APARSE_FILL_%zu=x", i);
+        wide_env[i] = fillers[i];
+    }
+    memcpy(wide_env + ARRSZ(fillers), env, sizeof(env));
+    args[0].env = "APARSE_TEST_NUM";
+    args[1].env = "APARSE_TEST_FLAG";
+    args[2].env = "APARSE_TEST_SCALE";
+    args[3].env = "APARSE_TEST_NAME";
+    aparse_schema *schema = aparse_compile(args);
+    aparse_parser *parser = aparse_parser_new(schema, NULL);
+    CHECK(parser);
+    aparse_parser_set_error_callback(parser, error_callback, &g_verbose);
+
+    CHECK(parse_env(parser, argv, env) == APARSE_STATUS_OK);
+    CHECK(values.num == 7 && values.flag == 1 && values.scale == 0.0);
+    CHECK(!strcmp(values.name, "from-env"));
+
+    // Looked up without an index, the same values
+    memset(&values, 0, sizeof(values));
+    aparse_parser_set_no_alloc(parser, region, sizeof(region));
+    CHECK(parse_env(parser, argv, wide_env) == APARSE_STATUS_OK);
+    CHECK(values.num == 7 && values.flag == 1 && values.scale == 0.0);
+    CHECK(!strcmp(values.name, "from-env"));
+
+    aparse_parser_free(parser);
+    aparse_schema_free(schema);
+    return true;
+}
+
+// Converted like argv, so the same errors come back
+static bool check_env_invalid(void)
+{
+    env_values values = {0};
+    aparse_arg args[] = {
+        aparse_arg_option("-f", "--flag", &values.flag, 
+                sizeof(values.flag), APARSE_ARG_TYPE_BOOL, 0),
+        aparse_arg_option("-s", "--scale", &values.scale, 
+                sizeof(values.scale), APARSE_ARG_TYPE_FLOAT, 0),
+        aparse_arg_end_marker
+    };
+    const char *argv[] = {"tests", NULL};
+    const char *env[] = {"APARSE_TEST_FLAG=0", "APARSE_TEST_SCALE=x", NULL};
+    args[0].env = "APARSE_TEST_FLAG";
+    args[1].env = "APARSE_TEST_SCALE";
+    aparse_schema *schema = aparse_compile(args);
+    aparse_parser *parser = aparse_parser_new(schema, NULL);
+    CHECK(parser);
+    aparse_parser_set_error_callback(parser, error_callback, &g_verbose);
+
+    CHECK(parse_env(parser, argv, env) != APARSE_STATUS_OK);
+    CHECK(g_last_status == APARSE_STATUS_INVALID_VALUE);
+    CHECK(values.flag == 0 && values.scale == 0.0);
+
+    aparse_parser_free(parser);
+    aparse_schema_free(schema);
+    return true;
+}
+
+// Follows snprintf: the whole length, the text cut short in a small buffer
+static bool check_format_help(void)
+{
+    uint32_t count = 0;
+    int quiet = 0;
+    char full[1024], cut[160], usage[64];
+    const aparse_arg args[] = {
+        aparse_arg_option("-n", "--count", 
+                &count, sizeof(count), APARSE_ARG_TYPE_UNSIGNED,
+                "number of times the whole input is processed before "
+                "the results are written"),
+        aparse_arg_option("-q", "--quiet", 
+                &quiet, sizeof(quiet), APARSE_ARG_TYPE_BOOL,
+                "print nothing"),
+        aparse_arg_end_marker
+    };
+    const char *argv[] = {"tests", NULL};
+    size_t len = 0, usage_len = 0;
+    aparse_schema *schema = aparse_compile(args);
+    aparse_parser *parser = aparse_parser_new(schema, NULL);
+    CHECK(parser);
+    aparse_parser_set_error_callback(parser, error_callback, &g_verbose);
+    CHECK(parse_argv(parser, argv) == APARSE_STATUS_OK);
+
+    len = aparse_parser_format_help(parser, full, sizeof(full), 40);
+    CHECK(len < sizeof(full) && strlen(full) == len);
+    usage_len = aparse_parser_format_usage(parser, usage, sizeof(usage));
+    CHECK(usage_len < sizeof(usage) && strlen(usage) == usage_len);
+    // The help starts with the usage line, with the name of the last parse
+    CHECK(!strncmp(usage, "usage: tests [-n COUNT] [-q]", 28));
+    CHECK(!strncmp(full, usage, usage_len));
+    CHECK(strstr(full, "-n, --count COUNT") && strstr(full, "print nothing"));
+    // Wrapped at 40 columns
+    CHECK(!strstr(full, "input is processed"));
+
+    CHECK(aparse_parser_format_help(parser, cut, sizeof(cut), 40) == len);
+    CHECK(strlen(cut) == sizeof(cut) - 1 && !strncmp(full, cut, sizeof(cut) - 1));
+    CHECK(aparse_parser_format_help(parser, NULL, 0, 40) == len);
+
+    aparse_parser_free(parser);
+    aparse_schema_free(schema);
+    return true;
+}
+
+typedef struct sum_data { aparse_list nums; } sum_data;
+static uint32_t g_sum = 0;
+static void sum_command(const aparse_arg *arg, void* data) 
+{ 
+    const aparse_list *nums = &((sum_data*)data)->nums;
+    (void)arg;
+    for(size_t i = 0; i < nums->size; i++)
+        g_sum += aparse_list_get(nums, uint32_t, i);
+}
+
+// The caller's list inside a payload buffer is not released on dispatch
+static bool check_no_alloc_payload_array(void)
+{
+    _Alignas(max_align_t) uint8_t region[256];
+    uint32_t storage[4] = {0};
+    sum_data payload = {
+        .nums = {
+            .ptr = storage, 
+            .capacity = ARRSZ(storage), 
+            .itemsz = sizeof(uint32_t)
+        }
+    };
+    const aparse_arg subargs[] = {
+        aparse_arg_array("nums", NULL, sizeof(aparse_list), 0,
+                APARSE_ARG_TYPE_UNSIGNED, sizeof(uint32_t), 0),
+        aparse_arg_end_marker
+    };
+    const aparse_arg commands[] = {
+        aparse_arg_subparser("sum", subargs, sum_command, 
+                &payload, sizeof(payload), 0, sum_data, nums),
+        aparse_arg_end_marker
+    };
+    const aparse_arg args[] = {
+        aparse_arg_parser("command", commands),
+        aparse_arg_end_marker
+    };
+    const char *argv[] = {"tests", "sum", "1", "2", "3", NULL};
+    aparse_list dispatch_list = {0};
+    aparse_schema *schema = aparse_compile(args);
+    aparse_parser *parser = aparse_parser_new(schema, NULL);
+    CHECK(parser);
+    aparse_parser_set_error_callback(parser, error_callback, &g_verbose);
+    aparse_parser_set_no_alloc(parser, region, sizeof(region));
+
+    aparse_set_allocator(&heap_allocator);
+    for(int i = 0; i < 2; i++)
+    {
+        g_sum = 0;
+        CHECK(aparse_parse_ex(parser, ARRSZ(argv) - 1, 
+                    (char *const *)(uintptr_t)argv, &dispatch_list) == APARSE_STATUS_OK);
+        aparse_dispatch_all(&dispatch_list);
+        CHECK(g_sum == 6);
+        CHECK(payload.nums.ptr == storage && payload.nums.capacity == 4);
+    }
+    aparse_set_allocator(NULL);
+    CHECK(g_heap_calls == 0);
+
+    aparse_parser_free(parser);
+    aparse_schema_free(schema);
+    return true;
+}
+
+static const check_entry checks[] = {
+    { "no-alloc-payload-array", check_no_alloc_payload_array },
+    { "format-help", check_format_help },
+    { "env-fallback", check_env_fallback },
+    { "env-invalid", check_env_invalid },
+    { "string-view", check_string_view },
+    { "parse-batch", check_parse_batch },
+    { "no-alloc", check_no_alloc },
+    { "no-alloc-array", check_no_alloc_array },
+    { "alloc-stats", check_alloc_stats },
+    { "arena-repeat", check_arena_repeat },
+    { "lazy-getters", check_lazy_getters },
+    { "lazy-arena", check_lazy_arena },
+};
+
 int main(int argc, char** argv)
 {
     int flag_verbose = 0;
@@ -147,8 +850,9 @@ int main(int argc, char** argv)
     };
     if(aparse_parse(argc, argv, main_args, 0, 0) != APARSE_STATUS_OK)
         return 1;
+    g_verbose = flag_verbose;
    
-    uint8_t buffer[BUFFER_SIZE] = {0};
+    _Alignas(max_align_t) uint8_t buffer[BUFFER_SIZE] = {0};
     aparse_arg copy_subargs[] = {
         aparse_arg_string("file", 0, 32, "Source"),
         aparse_arg_string("dest", 0, 32, "Destionation"),
@@ -182,6 +886,114 @@ int main(int argc, char** argv)
                 APARSE_ARG_TYPE_UNSIGNED, 0),
         aparse_arg_end_marker
     };
+    aparse_arg f64_args[] = {
+        aparse_arg_number("num", 
+                buffer, sizeof(double), 
+                APARSE_ARG_TYPE_FLOAT, 0),
+        aparse_arg_end_marker
+    };
+    aparse_arg f32_args[] = {
+        aparse_arg_number("num", 
+                buffer, sizeof(float), 
+                APARSE_ARG_TYPE_FLOAT, 0),
+        aparse_arg_end_marker
+    };
+    aparse_arg u64_wide_args[] = {
+        aparse_arg_number("num", 
+                buffer, sizeof(uint64_t), 
+                APARSE_ARG_TYPE_UNSIGNED, 0),
+        aparse_arg_end_marker
+    };
+
+    // Read-only tables, payloads are allocated by the parser
+    const aparse_arg sink_subargs[] = {
+        aparse_arg_string("file", 0, 32, "Source"),
+        aparse_arg_string("dest", 0, 32, "Destionation"),
+        aparse_arg_end_marker
+    };
+    const aparse_arg sink_command_args[] = {
+        aparse_arg_subparser("copy", sink_subargs, sink_command, 
+                NULL, 0, 0, copy_data, src, dest),
+        aparse_arg_end_marker
+    };
+    const aparse_arg sink_args[] = {
+        aparse_arg_parser("command", sink_command_args),
+        aparse_arg_end_marker
+    };
+    const aparse_arg sink_pair_commands[] = {
+        aparse_arg_subparser("copy", sink_subargs, sink_command, 
+                NULL, 0, 0, copy_data, src, dest),
+        aparse_arg_subparser("move", sink_subargs, sink_command, 
+                NULL, 0, 0, copy_data, src, dest),
+        aparse_arg_end_marker
+    };
+    const aparse_arg sink_pair_args[] = {
+        aparse_arg_parser("first", sink_pair_commands),
+        aparse_arg_parser("second", sink_pair_commands),
+        aparse_arg_end_marker
+    };
+    const aparse_dispatch_dep copy_after_move[] = {
+        {.name = "copy", .after = "move"}
+    };
+
+    aparse_list nums = {
+        .ptr = buffer, 
+        .capacity = 4, 
+        .itemsz = sizeof(uint32_t)
+    };
+    const aparse_arg array_args[] = {
+        aparse_arg_array("nums", &nums, sizeof(nums), 0,
+                APARSE_ARG_TYPE_UNSIGNED, sizeof(uint32_t), 0),
+        aparse_arg_end_marker
+    };
+    size_t stream_itemsz = sizeof(uint32_t);
+    aparse_stream stream = {
+        .callback = sink_values,
+        .userdata = &stream_itemsz,
+        .batch = 2
+    };
+    const aparse_arg stream_args[] = {
+        aparse_arg_stream("nums", &stream, 
+                APARSE_ARG_TYPE_UNSIGNED, sizeof(uint32_t), 0),
+        aparse_arg_end_marker
+    };
+
+    aparse_list wide_nums = {
+        .ptr = buffer, 
+        .capacity = 4, 
+        .itemsz = sizeof(int64_t)
+    };
+    const aparse_arg i64_array_args[] = {
+        aparse_arg_array("nums", &wide_nums, sizeof(wide_nums), 0,
+                APARSE_ARG_TYPE_SIGNED, sizeof(int64_t), 0),
+        aparse_arg_end_marker
+    };
+
+    aparse_list bounded_nums = {
+        .ptr = buffer, 
+        .capacity = 4, 
+        .itemsz = sizeof(uint32_t)
+    };
+    const aparse_arg bounded_args[] = {
+        aparse_arg_array_n("nums", &bounded_nums, sizeof(bounded_nums), 1, 2,
+                APARSE_ARG_TYPE_UNSIGNED, sizeof(uint32_t), 0),
+        aparse_arg_number("tail", buffer + 4 * sizeof(uint32_t), 
+                sizeof(uint32_t), APARSE_ARG_TYPE_UNSIGNED, 0),
+        aparse_arg_option("-f", "--flag", 
+                buffer + 5 * sizeof(uint32_t), sizeof(buffer[0]), 
+                APARSE_ARG_TYPE_BOOL, 0),
+        aparse_arg_end_marker
+    };
+
+    aparse_arg option_args[] = {
+        aparse_arg_option("-n", "--num", 
+                buffer, sizeof(uint32_t), 
+                APARSE_ARG_TYPE_UNSIGNED, 0),
+        aparse_arg_option("-f", "--flag", 
+                buffer + sizeof(uint32_t), sizeof(buffer[0]), 
+                APARSE_ARG_TYPE_BOOL, 0),
+        aparse_arg_end_marker
+    };
 
     const test_entry tests[] = 
     {
@@ -249,6 +1061,110 @@ int main(int argc, char** argv)
             .expected = APARSE_STATUS_OVERFLOW,
             .hash = BUFFER_ZEROED_HASH
         },
+        {
+            .name = "u64-max", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "18446744073709551615"}, 
+            .args = u64_wide_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0x4F0C17BD
+        },
+        {
+            .name = "u64-digits", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "1234567890123456789"}, 
+            .args = u64_wide_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0x25B3547C
+        },
+        {
+            .name = "u64-hex-of", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "0x10000000000000000"}, 
+            .args = u64_wide_args, 
+            .expected = APARSE_STATUS_OVERFLOW,
+            .hash = BUFFER_ZEROED_HASH
+        },
+        {
+            .name = "i8-min", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "-128"}, 
+            .args = i64_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0xEDD30545
+        },
+        {
+            .name = "i8-uf", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "-129"}, 
+            .args = i64_args, 
+            .expected = APARSE_STATUS_UNDERFLOW,
+            .hash = BUFFER_ZEROED_HASH
+        },
+        {
+            .name = "f64-round", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "0.1"}, 
+            .args = f64_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0x53B2C464
+        },
+        {
+            .name = "f64-halfway", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "9007199254740993"}, 
+            .args = f64_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0x217918AC
+        },
+        {
+            .name = "f64-long-even", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "1.00000000000000011102230246251565404236316680908203125"}, 
+            .args = f64_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0xB6DCA178
+        },
+        {
+            .name = "f64-long-up", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "1.000000000000000111022302462515654042363166809082031251"}, 
+            .args = f64_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0x2C7F0599
+        },
+        {
+            .name = "f64-of", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "1e309"}, 
+            .args = f64_args, 
+            .expected = APARSE_STATUS_OVERFLOW,
+            .hash = BUFFER_ZEROED_HASH
+        },
+        {
+            .name = "f64-invalid", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "1,5"}, 
+            .args = f64_args, 
+            .expected = APARSE_STATUS_INVALID_VALUE,
+            .hash = BUFFER_ZEROED_HASH
+        },
+        {
+            .name = "f32-round", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "-3.4028235e38"}, 
+            .args = f32_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0x71399E21
+        },
+        {
+            .name = "f32-uf", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "1e-50"}, 
+            .args = f32_args, 
+            .expected = APARSE_STATUS_UNDERFLOW,
+            .hash = BUFFER_ZEROED_HASH
+        },
         {
             .name="valid-cmd", 
             .argc=4, 
@@ -256,32 +1172,191 @@ int main(int argc, char** argv)
             .args = args_1, 
             .expected = APARSE_STATUS_OK,
             .hash = 0xA0A33A83
-        },    
+        },
+        {
+            .name="compiled-cmd", 
+            .argc=4, 
+            .argv = (const char*[]){"tests", "copy", "fox", "binary"},
+            .args = args_1, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0xA0A33A83,
+            .compiled = true
+        },
+        {
+            .name = "compiled-invalid-cmd", 
+            .argc = 2, 
+            .argv = (const char*[]){"tests", "cop"},
+            .args = args_1, 
+            .expected = APARSE_STATUS_INVALID_SUBCOMMAND,
+            .hash = BUFFER_ZEROED_HASH,
+            .compiled = true
+        },
+        {
+            .name="compiled-opt", 
+            .argc=3, 
+            .argv = (const char*[]){"tests", "--num=42", "-f"},
+            .args = option_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0x065D7BFE,
+            .compiled = true
+        },
+        {
+            .name="compiled-unknown", 
+            .argc=3, 
+            .argv = (const char*[]){"tests", "--nu=42", "-f"},
+            .args = option_args, 
+            .expected = APARSE_STATUS_UNKNOWN_ARGUMENT,
+            .hash = 0x92FBABD4,
+            .compiled = true
+        },
+        {
+            .name="parser-cmd", 
+            .argc=4, 
+            .argv = (const char*[]){"tests", "copy", "fox", "binary"},
+            .args = args_1, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0xA0A33A83,
+            .reentrant = true
+        },
+        {
+            .name="parser-unknown", 
+            .argc=3, 
+            .argv = (const char*[]){"tests", "--nu=42", "-f"},
+            .args = option_args, 
+            .expected = APARSE_STATUS_UNKNOWN_ARGUMENT,
+            .hash = 0x92FBABD4,
+            .reentrant = true
+        },
+        {
+            .name="const-repeat", 
+            .argc=4, 
+            .argv = (const char*[]){"tests", "copy", "fox", "binary"},
+            .args = sink_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0xCDA778C3,
+            .repeat = 3
+        },
+        {
+            .name="array", 
+            .argc=4, 
+            .argv = (const char*[]){"tests", "1", "2", "3"},
+            .args = array_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0x10FD44C5,
+            .reentrant = true,
+        },
+        {
+            .name="array-full", 
+            .argc=6, 
+            .argv = (const char*[]){"tests", "1", "2", "3", "4", "5"},
+            .args = array_args, 
+            .expected = APARSE_STATUS_ALLOC_FAILURE,
+            .hash = BUFFER_ZEROED_HASH,
+            .reentrant = true,
+        },
+        {
+            // decimal digits in blocks of 8, and prefixed values
+            .name="array-i64", 
+            .argc=5, 
+            .argv = (const char*[]){"tests", 
+                "-9223372036854775808", "0x7f", "1234567890123", "-0"},
+            .args = i64_array_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0xBE706939,
+            .reentrant = true,
+        },
+        {
+            // the dependency puts move first in the sink
+            .name="dispatch-parallel", 
+            .argc=7, 
+            .argv = (const char*[]){"tests", 
+                "copy", "a", "b", "move", "c", "d"},
+            .args = sink_pair_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0xC9BE29C1,
+            .reentrant = true,
+            .dispatch_threads = 2,
+            .deps = copy_after_move,
+            .dep_count = ARRSZ(copy_after_move)
+        },
+        {
+            // two values at most, then the positional and the option
+            .name="bounded-array", 
+            .argc=5, 
+            .argv = (const char*[]){"tests", "1", "2", "3", "-f"},
+            .args = bounded_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0x478E1034,
+            .reentrant = true,
+        },
+        {
+            // batches of 2, then the remainder
+            .name="stream-batch", 
+            .argc=6, 
+            .argv = (const char*[]){"tests", "1", "2", "3", "4", "5"},
+            .args = stream_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0x6F4B02C4,
+        },
+        {
+            .name="response-file-missing", 
+            .argc=3, 
+            .argv = (const char*[]){"tests", "1", "@/nonexistent/aparse.rsp"},
+            .args = array_args, 
+            .expected = APARSE_STATUS_RESPONSE_FILE,
+            .hash = BUFFER_ZEROED_HASH,
+            .reentrant = true,
+            .response_files = true
+        },
+        {
+            .name="threads-array", 
+            .argc=5, 
+            .argv = (const char*[]){"tests", "1", "2", "3", "4"},
+            .args = array_args, 
+            .expected = APARSE_STATUS_OK,
+            .hash = 0x71A28181,
+            .reentrant = true,
+            .threads = 3
+        },
+        {
+            // the lowest failing index wins, whichever chunk ends first
+            .name="threads-array-invalid", 
+            .argc=5, 
+            .argv = (const char*[]){"tests", "1", "x", "3", "0x1ffffffff"},
+            .args = array_args, 
+            .expected = APARSE_STATUS_INVALID_VALUE,
+            .hash = 0x56CB4467,
+            .reentrant = true,
+            .threads = 4
+        },
     };
 
     if(!strcmp(test_name, "all"))
     {
         int success_count = 0, failed_count = 0;
-        for(size_t i = 0; i < ARRSZ(tests); i++)
+        for(size_t i = 0; i < ARRSZ(tests) + ARRSZ(checks); i++)
         {
-            const test_entry *entry = &tests[i];
+            const bool is_check = i >= ARRSZ(tests);
+            const char *name = is_check ? 
+                checks[i - ARRSZ(tests)].name : tests[i].name;
             int res = 0;
             aparse_status status = APARSE_STATUS_OK;
 
-            res = spawn_process(tests[i], flag_verbose);
+            res = spawn_process(name, flag_verbose);
             status = (aparse_status)res;
-            aparse_status expected_status = tests[i].expected;
+            aparse_status expected_status = is_check ? 
+                APARSE_STATUS_OK : tests[i].expected;
             int fail = status != expected_status;
     
             if(fail) 
             {
-                error("test %zu (\"%s\"): failed", i + 1, entry->name);
+                error("test %zu (\"%s\"): failed", i + 1, name);
                 info("expected: %s, got: %s", 
                         status_string(expected_status), 
                         status_string(status));
                 failed_count++;
             } else {
-                info("test %zu (\"%s\"): passed", i + 1, entry->name);
+                info("test %zu (\"%s\"): passed", i + 1, name);
                 success_count++;
             }
         }
@@ -294,6 +1369,12 @@ int main(int argc, char** argv)
         const test_entry *entry = NULL;
         uint32_t hash = 0;
 
+        for(size_t i = 0; i < ARRSZ(checks); i++)
+        {
+            if(!strcmp(test_name, checks[i].name))
+                return checks[i].run() ? 
+                    (int)APARSE_STATUS_OK : (int)APARSE_STATUS_FAILURE;
+        }
         for(size_t i = 0; i < ARRSZ(tests); i++)
         {
             if(!strcmp(test_name, tests[i].name))
@@ -309,14 +1390,56 @@ int main(int argc, char** argv)
             info(" - all");
             for(size_t i = 0; i < ARRSZ(tests); i++)
                 info(" - %s", tests[i].name);
+            for(size_t i = 0; i < ARRSZ(checks); i++)
+                info(" - %s", checks[i].name);
             return 1;
         }
 
         entry = &tests[test_idx];
-        aparse_set_error_callback(error_callback, &flag_verbose);
-        aparse_parse(
-                entry->argc, (char *const *)(uintptr_t)entry->argv, 
-                entry->args, NULL, NULL);
+        g_sink = buffer;
+        if(entry->reentrant)
+        {
+            _Alignas(max_align_t) uint8_t storage[4096];
+            aparse_schema *schema = aparse_compile(entry->args);
+            aparse_parser *parser = aparse_parser_new(schema, NULL);
+            if(!parser)
+                return (int)APARSE_STATUS_ALLOC_FAILURE;
+            // The global callback must not be consulted
+            aparse_parser_set_error_callback(parser, 
+                    error_callback, &flag_verbose);
+            aparse_parser_set_no_alloc(parser, storage, sizeof(storage));
+            aparse_parser_set_threads(parser, entry->threads, 1);
+            aparse_parser_set_response_files(parser, entry->response_files);
+            for(int i = 0; i < (entry->repeat > 1 ? entry->repeat : 1); i++)
+            {
+                aparse_list dispatch_list = {0};
+                aparse_parse_ex(parser,
+                        entry->argc, (char *const *)(uintptr_t)entry->argv, 
+                        entry->dispatch_threads ? &dispatch_list : NULL);
+                aparse_dispatch_parallel(&dispatch_list, entry->dispatch_threads,
+                        entry->deps, entry->dep_count, NULL);
+            }
+            aparse_parser_free(parser);
+            aparse_schema_free(schema);
+        } else if(entry->compiled)
+        {
+            aparse_set_error_callback(error_callback, &flag_verbose);
+            aparse_schema *schema = aparse_compile(entry->args);
+            if(!schema)
+                return (int)APARSE_STATUS_ALLOC_FAILURE;
+            aparse_parse_schema(
+                    entry->argc, (char *const *)(uintptr_t)entry->argv, 
+                    schema, NULL, NULL);
+            aparse_schema_free(schema);
+        } else {
+            aparse_set_error_callback(error_callback, &flag_verbose);
+            for(int i = 0; i < (entry->repeat > 1 ? entry->repeat : 1); i++)
+            {
+                aparse_parse(
+                        entry->argc, (char *const *)(uintptr_t)entry->argv, 
+                        entry->args, NULL, NULL);
+            }
+        }
         hash = fnv1a(buffer, sizeof(buffer));
         if(entry->hash != hash)
         {
@@ -29,6 +29,7 @@ SOFTWARE.
 #include <stdint.h>
 #include <stddef.h>
 
+#include <aparse_alloc.h>
 #include <aparse_list.h>
 
 /**
@@ -284,6 +285,12 @@ typedef enum aparse_arg_types
      */
     APARSE_ARG_TYPE_FLOAT,
 
+    /**
+     * @brief String view argument type.
+     * Stores an ::aparse_string_view into the input, nothing is copied.
+     */
+    APARSE_ARG_TYPE_STRING_VIEW,
+
     /**
      * @brief Array argument type.
      * Indicates that the argument points to a list of values 
@@ -304,6 +311,13 @@ typedef enum aparse_arg_types
      */
     APARSE_ARG_TYPE_ARGUMENT   = (1 << 5),
 
+    /**
+     * @brief Streaming array modifier.
+     * Combined with @ref APARSE_ARG_TYPE_ARRAY, values are handed to an
+     * ::aparse_stream callback instead of being stored.
+     */
+    APARSE_ARG_TYPE_STREAM     = (1 << 6),
+
     /**
      * @brief Subparser or subcommand argument type.
      * Equivalent to @ref APARSE_ARG_TYPE_POSITIONAL, 
@@ -337,6 +351,62 @@ typedef struct aparse_arg aparse_arg;
  */
 typedef void (*aparse_handler_t)(const aparse_arg *arg, void *data);
 
+/**
+ * @brief Consumer of the values of a streaming array.
+ *
+ * @param arg      The array argument.
+ * @param values   @p count converted elements, laid out as in an array
+ *                 (`char*` elements for strings).
+ * @param count    Number of elements, at least 1 and at most the batch size.
+ * @param userdata ::aparse_stream::userdata.
+ *
+ * @return `false` to stop parsing, which then fails with ::APARSE_STATUS_FAILURE.
+ *
+ * @note The values are only valid during the call.
+ */
+typedef bool (*aparse_stream_fn)(
+        const aparse_arg* arg, 
+        const void* values, 
+        size_t count, 
+        void* userdata);
+
+/**
+ * @brief Destination of a streaming array, see ::aparse_arg_stream.
+ */
+typedef struct aparse_stream
+{
+    /** Called for every batch of converted elements, in order. */
+    aparse_stream_fn callback;
+
+    /** User-defined pointer forwarded to @ref callback. */
+    void* userdata;
+
+    /** Elements per call, 0 for one at a time. */
+    size_t batch;
+
+    /**
+     * Storage for @ref batch elements, or `NULL` to convert into a 4 KiB
+     * buffer of the parser (@ref batch is then reduced to what fits).
+     */
+    void* buffer;
+} aparse_stream;
+
+/**
+ * @brief Destination of an ::APARSE_ARG_TYPE_STRING_VIEW argument.
+ *
+ * Points into `argv` (past the `=` of `--name=value`) or into a response
+ * file, and stays valid as long as they do. @ref ptr is still
+ * null-terminated, @ref len spares the handler another scan.
+ */
+typedef struct aparse_string_view
+{
+    /** First character of the value. */
+    const char* ptr;
+
+    /** Length of the value, without the terminator. */
+    size_t len;
+} aparse_string_view;
+
 /**
  * @struct aparse_arg
  * @brief Describes a single argument, option, or subparser definition.
@@ -347,6 +417,14 @@ typedef void (*aparse_handler_t)(const aparse_arg *arg, void *data);
  *
  * The meaning of certain members depends on the argument type
  * (see @ref aparse_arg_types).
+ *
+ * The parser never writes to a definition, all per-parse state is kept
+ * by the parse itself. Tables can therefore be declared `const` and
+ * shared between threads and consecutive parses.
+ *
+ * @note The `aparse_arg_*` builders are functions, so they only fill
+ *       tables with automatic storage. A `static const` table is written
+ *       with designated initializers, or generated by `script/schema_gen.py`.
  */
 typedef struct aparse_arg
 {
@@ -382,13 +460,6 @@ typedef struct aparse_arg
      */
     aparse_arg_types type : 8;
 
-    /**
-     * @brief Internal parser flags to track parsing process.
-     *
-     * Typically not set manually by the user.
-     */
-    uint8_t flags;
-
     /**
      * @brief Type-dependent size or count parameter.
      *
@@ -434,13 +505,17 @@ typedef struct aparse_arg
              * @brief Size of each element for array arguments.
              */
             size_t element_size;
+            /**
+             * @brief Maximum number of elements of array arguments, 0 for no limit.
+             */
+            size_t array_max;
         };
         // For subparsers/subcommands
         struct {
             /**
              * @brief Array of subarguments used in the subcommand.
              */
-            struct aparse_arg* subargs;
+            const struct aparse_arg* subargs;
 
             /**
              * @brief Handler function called after successful subparser parsing.
@@ -473,6 +548,15 @@ typedef struct aparse_arg
             size_t layout_size;
         };
     };
+
+    /**
+     * @brief Environment variable used when the argument is not on the command line.
+     *
+     * Its value goes through the same conversion as one from `argv`, a
+     * boolean is set unless the variable is empty or `0`. Only read for
+     * single-value arguments, may be `NULL`.
+     */
+    const char* env;
 } aparse_arg;
 
 /**
@@ -503,10 +587,101 @@ typedef enum aparse_status
     APARSE_STATUS_ALLOC_FAILURE,        /**< Memory allocation failed. */
     APARSE_STATUS_UNHANDLED,            /**< Unhandled type of argument. */
     APARSE_STATUS_TOO_DEEP,             /**< Parser nesting depth exceeded the limit */
+    APARSE_STATUS_RESPONSE_FILE,        /**< Response file could not be read */
 
     __APARSE_STATUS_ENUM_END__          /**< The marker for the end of aparse_status. THIS MUST BE AT THE END */
 } aparse_status;
 
+/**
+ * @brief A compiled level of an argument table.
+ *
+ * Each node mirrors one ::aparse_arg array, either the arguments of a
+ * parser level or the subcommands of a parser argument. Nodes are built
+ * by ::aparse_compile, or emitted as static tables by `script/schema_gen.py`.
+ *
+ * @note This layout is shared with generated code, it is not meant to
+ *       be filled by hand.
+ */
+typedef struct aparse_schema_node
+{
+    /** The argument table this node was compiled from. */
+    const aparse_arg *args;
+
+    /** Number of entries in @ref args, excluding the end marker. */
+    size_t count;
+
+    /**
+     * @brief Name index, `NULL` if the level has nothing to look up.
+     *
+     * Entries are `((arg_index << 1) | is_short) + 1`, 0 marks an empty bucket.
+     * Parser levels index their option names, subcommand lists index
+     * the subcommand names.
+     */
+    const uint32_t *index;
+
+    /** Number of buckets in @ref index. */
+    uint32_t index_size;
+
+    /**
+     * @brief Per-bucket displacement of a minimal perfect hash.
+     *
+     * `NULL` for indexes built at runtime, which use open addressing over
+     * a power-of-two @ref index_size instead.
+     */
+    const uint32_t *displace;
+
+    /** Number of entries in @ref displace. */
+    uint32_t displace_size;
+
+    /** Indices of the positional entries of @ref args, in order. */
+    const uint32_t *positionals;
+
+    /** Number of entries in @ref positionals. */
+    size_t positional_count;
+
+    /** Per argument, the node compiled from its `subargs` (or `NULL`). */
+    const struct aparse_schema_node *const *children;
+
+    /** Indices of the entries of @ref args with an `env` name, in order. */
+    const uint32_t *envs;
+
+    /** Number of entries in @ref envs. */
+    size_t env_count;
+} aparse_schema_node;
+
+/**
+ * @brief Compiled argument schema.
+ *
+ * Produced by ::aparse_compile from an ::aparse_arg table. It holds a hash
+ * index over the option names of every parser level and over the names of
+ * every subcommand list, so neither matching an argv token nor selecting a
+ * subcommand walks the argument table.
+ *
+ * The schema only references the source table, which must outlive it.
+ * Once compiled, the index is never modified and can be reused by any
+ * number of ::aparse_parse_schema calls.
+ */
+typedef struct aparse_schema
+{
+    /** The node of the top-level argument table. */
+    const aparse_schema_node *root;
+
+    /** Nodes owned by the schema, empty for generated schemas. */
+    aparse_list nodes;
+} aparse_schema;
+
+/**
+ * @brief Reentrant parser handle.
+ *
+ * Binds a compiled schema to the settings that used to be process-global:
+ * the program description, the error callback and its userdata. All the
+ * state of a parse lives on the stack of ::aparse_parse_ex, so one schema
+ * can be shared by any number of parsers, each used from its own thread.
+ *
+ * Created with ::aparse_parser_new and released with ::aparse_parser_free.
+ */
+typedef struct aparse_parser aparse_parser;
+
 /**
  * @brief Opaque parsing context.
  *
@@ -543,6 +718,7 @@ typedef struct aparse_context aparse_context;
  * | ::APARSE_STATUS_ALLOC_FAILURE      | `NULL`                 | `NULL`                 | Memory allocation failed inside parser.           |
  * | ::APARSE_STATUS_UNHANDLED          | `current_arg`          | `NULL`                 | An unhandled type of argument.                    |
  * | ::APARSE_STATUS_TOO_DEEP           | `NULL`                 | `NULL`                 | Parser nesting depth exceeded the limit           |
+ * | ::APARSE_STATUS_RESPONSE_FILE      | `path`                 | `NULL`                 | Response file (`-` for stdin) that could not be read. |
  *
  * - `const aparse_list* unknown_args  `: An aparse_list refer to a list of arguments. `unknown_args.ptr` should be converted into `aparse_arg*`
  * - `const aparse_arg*  current_arg   `: An aparse_arg* refer to the currently processed argument.
@@ -551,6 +727,7 @@ typedef struct aparse_context aparse_context;
  * - `const aparse_list* required_args `: An aparse_list refer to a list of required arguments. `required_args.ptr` should be converted into `aparse_arg*`
  * - `const int*         size          `: The invalid size of `current_arg`. It can be `current_arg.size` or `current_arg.element_size`
  * - `const int*         index         `: The base index of current entry inside `current_arg.data_layout`
+ * - `const char*        path          `: The path following `@`
  */
 typedef void (*aparse_error_callback)(
         const aparse_context *ctx,
@@ -642,8 +819,8 @@ APARSE_INLINE aparse_arg aparse_arg_option(
     return (aparse_arg){
         .shortopt = shortopt, 
         .longopt = longopt,
-        .type = type | 
-            APARSE_ARG_TYPE_ARGUMENT, 
+        .type = (aparse_arg_types)(type | 
+            APARSE_ARG_TYPE_ARGUMENT), 
         .ptr = dest, 
         .size = size, 
         .help = help,
@@ -676,9 +853,9 @@ APARSE_INLINE aparse_arg aparse_arg_number(
         .ptr = dest, 
         .size = size, 
         .help = help,
-        .type = type | 
+        .type = (aparse_arg_types)(type | 
             APARSE_ARG_TYPE_POSITIONAL | 
-            APARSE_ARG_TYPE_ARGUMENT
+            APARSE_ARG_TYPE_ARGUMENT)
     };    
 }
 
@@ -714,6 +891,34 @@ APARSE_INLINE aparse_arg aparse_arg_string(
     };
 }
 
+/**
+ * @brief Create a positional string view argument.
+ *
+ * Like ::aparse_arg_string, but @p dest receives the position and length
+ * of the value in the input instead of a copy.
+ *
+ * @param name  Argument name (used for help and matching).
+ * @param dest  Destination ::aparse_string_view.
+ * @param help  Optional help string to describe this argument.
+ *
+ * @return A fully constructed ::aparse_arg definition for string view positional arguments.
+ */
+APARSE_INLINE aparse_arg aparse_arg_string_view(
+        const char* name, 
+        aparse_string_view* dest, 
+        const char* help) 
+{
+    return (aparse_arg) {
+        .longopt = name, 
+        .ptr = dest, 
+        .size = sizeof(*dest),
+        .help = help,
+        .type = APARSE_ARG_TYPE_STRING_VIEW |
+            APARSE_ARG_TYPE_POSITIONAL |
+            APARSE_ARG_TYPE_ARGUMENT
+    };
+}
+
 /**
  * @brief Create a subparser definition.
  *
@@ -742,7 +947,7 @@ APARSE_INLINE aparse_arg aparse_arg_string(
  */
 APARSE_INLINE aparse_arg aparse_arg_subparser_impl(
         const char* name,
-        aparse_arg* subargs, 
+        const aparse_arg* subargs, 
         const aparse_handler_t handler,
         void *buffer, 
         const size_t size,
@@ -776,7 +981,7 @@ APARSE_INLINE aparse_arg aparse_arg_subparser_impl(
  */
 APARSE_INLINE aparse_arg aparse_arg_parser(
         const char* name, 
-        aparse_arg* subparsers) 
+        const aparse_arg* subparsers) 
 {
     return (aparse_arg){
         .longopt = name, 
@@ -790,6 +995,7 @@ APARSE_INLINE aparse_arg aparse_arg_parser(
  *
  * Defines a positional argument that stores multiple values (array behavior).
  * Useful for arguments that can appear multiple times or accept lists of items.
+ * The values run until the next recognized option or the end of the command line.
  *
  * @param name           Argument name.
  * @param dest           Pointer to the array where parsed values will be stored.
@@ -813,11 +1019,90 @@ APARSE_INLINE aparse_arg aparse_arg_array(
     return (aparse_arg){
         .longopt = name, .ptr = dest, .size = size,
         .array_size = array_size / (element_size == 0 ? sizeof(char*) : element_size),
-        .type = 
+        .type = (aparse_arg_types)(
             APARSE_ARG_TYPE_ARGUMENT | 
             APARSE_ARG_TYPE_ARRAY | 
             APARSE_ARG_TYPE_POSITIONAL | 
-            type,
+            type),
+        .help = help, .element_size = element_size
+    };
+}
+
+/**
+ * @brief Create an array argument definition with bounded element count.
+ *
+ * The array takes between @p min_count and @p max_count values. It stops
+ * early at the next recognized option, so other positionals and options
+ * can follow it.
+ *
+ * @param name           Argument name.
+ * @param dest           Pointer to the ::aparse_list receiving the values.
+ * @param size           Size of @p dest.
+ * @param min_count      Minimum number of values.
+ * @param max_count      Maximum number of values, 0 for no limit.
+ * @param type           Element type (see ::aparse_arg_types).
+ * @param element_size   Size of each array element in bytes (0 for pointer arrays).
+ * @param help           Optional help string.
+ *
+ * @return A fully constructed ::aparse_arg definition representing an array argument.
+ *
+ * @note Fewer than @p min_count values report ::APARSE_STATUS_MISSING_VALUE,
+ *       values beyond @p max_count are parsed as the following arguments.
+ */
+APARSE_INLINE aparse_arg aparse_arg_array_n(
+        const char* name, 
+        void* dest, 
+        const size_t size, 
+        const size_t min_count, 
+        const size_t max_count, 
+        const aparse_arg_types type, 
+        const size_t element_size, 
+        const char* help) {
+    return (aparse_arg){
+        .longopt = name, .ptr = dest, .size = size,
+        .array_size = min_count, .array_max = max_count,
+        .type = (aparse_arg_types)(
+            APARSE_ARG_TYPE_ARGUMENT | 
+            APARSE_ARG_TYPE_ARRAY | 
+            APARSE_ARG_TYPE_POSITIONAL | 
+            type),
+        .help = help, .element_size = element_size
+    };
+}
+
+/**
+ * @brief Create a streaming array argument definition.
+ *
+ * Like ::aparse_arg_array, it takes the following arguments, but nothing
+ * is stored: elements are converted in batches and handed to the callback
+ * of @p stream. Given as a single `-`, the values are read from `stdin`
+ * instead, separated by whitespace.
+ *
+ * @param name           Argument name.
+ * @param stream         Callback and batching of the values.
+ * @param type           Element type (see ::aparse_arg_types).
+ * @param element_size   Size of each element in bytes (0 for `char*` strings).
+ * @param help           Optional help string.
+ *
+ * @return A fully constructed ::aparse_arg definition representing a streaming array.
+ *
+ * @note Memory use does not depend on the number of values, a float that
+ *       underflows is reported and left out of the stream.
+ */
+APARSE_INLINE aparse_arg aparse_arg_stream(
+        const char* name, 
+        aparse_stream* stream, 
+        const aparse_arg_types type, 
+        const size_t element_size, 
+        const char* help) {
+    return (aparse_arg){
+        .longopt = name, .ptr = stream, .size = sizeof(*stream),
+        .type = (aparse_arg_types)(
+            APARSE_ARG_TYPE_ARGUMENT | 
+            APARSE_ARG_TYPE_ARRAY | 
+            APARSE_ARG_TYPE_STREAM | 
+            APARSE_ARG_TYPE_POSITIONAL | 
+            type),
         .help = help, .element_size = element_size
     };
 }
@@ -871,11 +1156,389 @@ static inline bool aparse_arg_nend(const aparse_arg* arg) {
 aparse_status aparse_parse(
         const int argc, 
         char* const * argv, 
-        aparse_arg* args, 
+        const aparse_arg* args, 
         aparse_list* dispatch_list_out, 
         const char* program_desc
 );
 
+/**
+ * @brief Compile an argument table into a schema.
+ *
+ * Walks @p args and every subcommand reachable from it, building a hash
+ * index over the short and long option names of each level (the `=value`
+ * part of an argv token is ignored during lookup) and one over the
+ * subcommands of each parser argument.
+ *
+ * @param args Argument definition table, terminated with ::aparse_arg_end_marker.
+ *
+ * @return The compiled schema, or `NULL` if @p args is `NULL` or an allocation failed.
+ *
+ * @note The table must not be modified while the schema is in use, adding or
+ *       renaming options requires compiling it again.
+ */
+aparse_schema* aparse_compile(const aparse_arg* args);
+
+/**
+ * @brief Release a schema created by ::aparse_compile.
+ *
+ * @param schema The schema to free, may be `NULL`.
+ *
+ * @warning Schemas emitted by `script/schema_gen.py` are static and must
+ *          not be passed to this function.
+ */
+void aparse_schema_free(aparse_schema* schema);
+
+/**
+ * @brief Parse command-line arguments against a compiled schema.
+ *
+ * Behaves like ::aparse_parse, except that options are matched through
+ * the index of @p schema in constant time.
+ *
+ * @param argc              Argument count (from `main`).
+ * @param argv              Argument vector (from `main`).
+ * @param schema            Schema created by ::aparse_compile.
+ * @param dispatch_list_out Optional output for the list of dispatched function
+ * @param program_desc      Optional program description for `--help` output (may be NULL).
+ *
+ * @return One of the ::aparse_status codes, typically ::APARSE_STATUS_OK on success.
+ */
+aparse_status aparse_parse_schema(
+        const int argc, 
+        char* const * argv, 
+        const aparse_schema* schema, 
+        aparse_list* dispatch_list_out, 
+        const char* program_desc
+);
+
+/**
+ * @brief Create a parser for a compiled schema.
+ *
+ * The parser starts with the error callback registered through
+ * ::aparse_set_error_callback at creation time, and never reads any global
+ * state afterwards.
+ *
+ * @param schema       Schema created by ::aparse_compile or `script/schema_gen.py`.
+ * @param program_desc Optional program description for `--help` output (may be NULL).
+ *
+ * @return The parser, or `NULL` if @p schema is `NULL` or the allocation failed.
+ *
+ * @note The schema must outlive the parser.
+ */
+aparse_parser* aparse_parser_new(
+        const aparse_schema* schema,
+        const char* program_desc
+);
+
+/**
+ * @brief Release a parser created by ::aparse_parser_new.
+ * @param parser The parser to free, may be `NULL`.
+ */
+void aparse_parser_free(aparse_parser* parser);
+
+/**
+ * @brief Set the error callback of a single parser.
+ *
+ * Same as ::aparse_set_error_callback, but only affects @p parser.
+ *
+ * @param parser    The parser to configure.
+ * @param cb        Pointer to a callback function of type ::aparse_error_callback.
+ * @param userdata  User-defined pointer passed to the callback on each invocation.
+ *
+ * @note Passing `NULL` as @p cb using the library default callback.
+ */
+void aparse_parser_set_error_callback(
+        aparse_parser* parser,
+        const aparse_error_callback cb, 
+        void* userdata);
+
+/**
+ * @brief Set the allocator used by the parses done with @p parser.
+ *
+ * Every parse-time allocation goes through @p allocator, and lists handed
+ * back to the caller carry it as their allocator.
+ *
+ * @param parser    The parser to configure.
+ * @param allocator The allocator to use, or `NULL` for the default one
+ *                  (see ::aparse_set_allocator). It is referenced, not copied.
+ */
+void aparse_parser_set_allocator(
+        aparse_parser* parser,
+        const aparse_allocator* allocator);
+
+/**
+ * @brief Allocation counters of the last parse done with @p parser.
+ *
+ * Covers every allocation made between the start of ::aparse_parse_ex and
+ * its return, including memory handed over to the caller, but not the
+ * execution of the dispatched handlers.
+ *
+ * @return The counters, all zero before the first parse.
+ */
+aparse_alloc_stats aparse_parser_alloc_stats(
+        const aparse_parser* parser);
+
+/**
+ * @brief Where the last parse of a parser spent its time.
+ *
+ * Only filled when aparse is built with `APARSE_STATS` defined (the
+ * `APARSE_STATS` CMake option), otherwise the probes compile to nothing
+ * and every field stays zero. Phases are timed with the time-stamp
+ * counter where there is one, scaled to nanoseconds against the wall
+ * time of the whole parse, and with `timespec_get` elsewhere.
+ *
+ * @note Allocations are also counted in the phase that made them.
+ */
+typedef struct aparse_stats
+{
+    uint64_t match_ns;    /**< Matching tokens against the arguments. */
+    uint64_t convert_ns;  /**< Converting values, array elements included. */
+    uint64_t layout_ns;   /**< Verifying the data layouts of subcommands. */
+    uint64_t alloc_ns;    /**< Inside the allocator. */
+    uint64_t missing_ns;  /**< Checking for missing required arguments. */
+    uint64_t dispatch_ns; /**< Running handlers, when no dispatch list is returned. */
+    uint64_t total_ns;    /**< The whole of ::aparse_parse_ex. */
+    size_t tokens;        /**< Tokens consumed, response file contents included. */
+    size_t matches;       /**< Tokens matched to an argument. */
+} aparse_stats;
+
+/**
+ * @brief Phase timings and counters of the last parse done with @p parser.
+ *
+ * @return The statistics, all zero before the first parse or when aparse
+ *         was built without `APARSE_STATS`.
+ */
+aparse_stats aparse_parser_stats(
+        const aparse_parser* parser);
+
+/**
+ * @brief Route every allocation of the parses done with @p parser into an arena.
+ *
+ * Array storage, subcommand payloads, the dispatch list and all the
+ * temporary lists of a parse are carved from @p arena. Lists handed back
+ * to the caller carry the arena as their allocator, so the usual
+ * ::aparse_list_free and ::aparse_dispatch_free calls stay valid (and cost
+ * nothing), while ::aparse_arena_reset releases the whole parse at once.
+ *
+ * @param parser The parser to configure.
+ * @param arena  Initialized arena, or `NULL` to go back to the default allocator.
+ *
+ * @warning Values parsed into arena memory are only valid until the arena
+ *          is reset, and the arena must not be shared by concurrent parses.
+ */
+void aparse_parser_set_arena(
+        aparse_parser* parser,
+        aparse_arena* arena);
+
+/**
+ * @brief Make every parse done with @p parser allocation-free.
+ *
+ * In this mode a parse never calls any allocator:
+ * - Arrays are written into the storage of their destination ::aparse_list
+ *   when it has one (`ptr` set, `capacity` elements of `itemsz` bytes),
+ *   and are carved from @p region otherwise. Caller storage stays owned by
+ *   the caller: the list gets an allocator that never frees it.
+ * - Subcommand payloads without a buffer of their own, the returned
+ *   dispatch list and the slots of very large levels come from @p region.
+ * - The unknown, dispatch and missing argument lists use fixed inline storage.
+ * - Environment fallbacks scan the environment on each lookup instead of
+ *   indexing it, so the region does not grow with the number of variables.
+ *
+ * Running out of any of them fails the parse with ::APARSE_STATUS_ALLOC_FAILURE,
+ * nothing falls back to the heap.
+ *
+ * @param parser The parser to configure.
+ * @param region Caller-owned memory, may be `NULL` if no parse needs it.
+ * @param size   Size of @p region in bytes.
+ *
+ * @note The region is reset at the start of every parse, so anything carved
+ *       from it is only valid until the next parse with @p parser.
+ * @note ::aparse_parser_set_allocator and ::aparse_parser_set_arena leave this mode.
+ */
+void aparse_parser_set_no_alloc(
+        aparse_parser* parser,
+        void* region,
+        const size_t size);
+
+/**
+ * @brief Convert large arrays of the parses done with @p parser on several threads.
+ *
+ * Arrays of at least @p threshold elements are split into one chunk per
+ * thread, converted in parallel straight into their storage. Errors are
+ * reported as a serial conversion would: nonfatal ones in argv order, then
+ * the fatal one at the lowest failing index, which ends the parse.
+ *
+ * @param parser    The parser to configure.
+ * @param threads   Number of threads including the calling one, 0 or 1 to
+ *                  always convert serially (capped at 64).
+ * @param threshold Minimum number of elements, 0 picks a default of 4096.
+ *
+ * @note Elements after a failing one may already be converted, the size of
+ *       the list still stops at the failing index.
+ * @note Built with `APARSE_NO_THREADS`, the chunks all run on the calling thread.
+ */
+void aparse_parser_set_threads(
+        aparse_parser* parser,
+        const unsigned threads,
+        const size_t threshold);
+
+/**
+ * @brief Expand `@path` arguments of the parses done with @p parser.
+ *
+ * An argument `@path` is replaced by the arguments read from the file
+ * `path`: whitespace-separated tokens, where single or double quotes group
+ * whitespace into a token and a backslash escapes the next character.
+ * Files may reference other files.
+ *
+ * The file is memory-mapped copy-on-write and tokenized in place, so string
+ * values pointing into it are not copied. It is only read once the parser
+ * reaches the argument, as an option, an option value or part of an array.
+ *
+ * @param parser The parser to configure.
+ * @param enable Whether arguments starting with `@` name response files.
+ *
+ * @note Strings from a response file stay valid until the next parse with
+ *       @p parser or ::aparse_parser_free.
+ * @note A parse reads at most 32 files, the next one fails it with
+ *       ::APARSE_STATUS_TOO_DEEP (this also stops a file including itself).
+ *       A file that cannot be read fails it with ::APARSE_STATUS_RESPONSE_FILE.
+ */
+void aparse_parser_set_response_files(
+        aparse_parser* parser,
+        const bool enable);
+
+/**
+ * @brief Program name of the last parse done with @p parser.
+ *
+ * Per-parser replacement of `__aparse_progname`, for custom error callbacks.
+ *
+ * @return The executable name taken from `argv[0]`, or `NULL` before the first parse.
+ */
+const char* aparse_parser_progname(const aparse_parser* parser);
+
+/**
+ * @brief Defer number conversions of the parses done with @p parser.
+ *
+ * A numeric, non-array argument with its own destination (`ptr` set in
+ * the table, not a subcommand payload member) is only matched: the parse
+ * records its value string and leaves the destination alone. The first
+ * ::aparse_get_i64, ::aparse_get_u64 or ::aparse_get_f64 call for it
+ * converts the value into the destination, later calls reuse the result.
+ * A parse then costs tokenizing and matching, and a bad value is only
+ * reported if the program reads it.
+ *
+ * @param parser The parser to configure.
+ * @param enable Whether numbers are converted on first access.
+ *
+ * @note Conversion errors are returned by the getters instead of going
+ *       through the error callback, the parse itself succeeds.
+ * @note Has no effect in no-alloc mode (::aparse_parser_set_no_alloc).
+ * @note The recorded values come from the parser's allocator and are counted
+ *       by ::aparse_parser_alloc_stats, with an arena they are only kept
+ *       until it is reset.
+ */
+void aparse_parser_set_lazy(
+        aparse_parser* parser,
+        const bool enable);
+
+/**
+ * @brief Read a signed integer argument of the last parse with @p parser.
+ *
+ * Converts a value deferred by ::aparse_parser_set_lazy into the
+ * destination of @p arg on first access, then widens the destination
+ * (whatever its size) into @p value. An argument that was not given, or
+ * was parsed eagerly, just yields its destination.
+ *
+ * @param parser The parser that did the parse.
+ * @param arg    Entry of the argument table, an ::APARSE_ARG_TYPE_SIGNED argument.
+ * @param value  Set on success.
+ *
+ * @return ::APARSE_STATUS_OK, the (remembered) status of the conversion as
+ *         for ::aparse_convert_integer, ::APARSE_STATUS_INVALID_TYPE if
+ *         @p arg is not a single signed integer, or ::APARSE_STATUS_NULL_POINTER.
+ *
+ * @note Values stay available until the next parse with @p parser, and
+ *       getters must not run concurrently on the same parser.
+ */
+aparse_status aparse_get_i64(
+        aparse_parser* parser,
+        const aparse_arg* arg,
+        int64_t* value);
+
+/**
+ * @brief Read an unsigned integer argument, see ::aparse_get_i64.
+ */
+aparse_status aparse_get_u64(
+        aparse_parser* parser,
+        const aparse_arg* arg,
+        uint64_t* value);
+
+/**
+ * @brief Read a floating-point argument, see ::aparse_get_i64.
+ *
+ * @return As ::aparse_get_i64, with the statuses of ::aparse_convert_float.
+ *         A float ::APARSE_STATUS_UNDERFLOW leaves the destination as it was.
+ */
+aparse_status aparse_get_f64(
+        aparse_parser* parser,
+        const aparse_arg* arg,
+        double* value);
+
+/**
+ * @brief Render the help message of @p parser into @p buffer.
+ *
+ * The same text `-h`/`--help` prints for the top level, with the program
+ * name of the last parse. Follows `snprintf`: at most @p size - 1 bytes
+ * are written, always NUL-terminated when @p size is not 0.
+ *
+ * @param parser The parser whose arguments are described.
+ * @param buffer The destination, may be `NULL` when @p size is 0.
+ * @param size   The size of @p buffer in bytes.
+ * @param width  The column help texts wrap at, 0 for the terminal width.
+ *
+ * @return The length of the whole message; @p size or more means it was
+ *         truncated.
+ */
+size_t aparse_parser_format_help(
+        const aparse_parser* parser,
+        char* buffer,
+        const size_t size,
+        const int width);
+
+/**
+ * @brief Render the usage line of @p parser into @p buffer.
+ *
+ * Same conventions as ::aparse_parser_format_help.
+ *
+ * @return The length of the whole line; @p size or more means it was
+ *         truncated.
+ */
+size_t aparse_parser_format_usage(
+        const aparse_parser* parser,
+        char* buffer,
+        const size_t size);
+
+/**
+ * @brief Parse command-line arguments with a parser handle.
+ *
+ * Behaves like ::aparse_parse_schema, but reads every setting from
+ * @p parser instead of the process-global ones, and does not update
+ * `__aparse_progname`. Different parsers may parse concurrently, as long
+ * as their destinations do not overlap.
+ *
+ * @param parser            Parser created by ::aparse_parser_new.
+ * @param argc              Argument count (from `main`).
+ * @param argv              Argument vector (from `main`).
+ * @param dispatch_list_out Optional output for the list of dispatched function
+ *
+ * @return One of the ::aparse_status codes, typically ::APARSE_STATUS_OK on success.
+ */
+aparse_status aparse_parse_ex(
+        aparse_parser* parser,
+        const int argc, 
+        char* const * argv, 
+        aparse_list* dispatch_list_out
+);
+
 /**
  * @brief Dispatch all queued handle
  *
@@ -912,6 +1575,202 @@ extern int aparse_dispatch_contain(const aparse_list* dispatch_list, const char*
  */
 extern void aparse_dispatch_free(aparse_list* dispatch_list);
 
+/**
+ * @brief Ordering constraint of ::aparse_dispatch_parallel.
+ *
+ * The handlers of the subcommand named @ref name start only once every
+ * handler of the subcommand named @ref after has returned. Names are
+ * compared against `aparse_arg.longopt`, like ::aparse_dispatch_contain.
+ */
+typedef struct aparse_dispatch_dep
+{
+    /** The subcommand that waits. */
+    const char* name;
+
+    /** The subcommand that runs first. */
+    const char* after;
+} aparse_dispatch_dep;
+
+/**
+ * @brief Outcome of one queued handler, see ::aparse_dispatch_parallel.
+ */
+typedef struct aparse_dispatch_result
+{
+    /** The subcommand of the handler. */
+    const aparse_arg* args;
+
+    /** ::APARSE_STATUS_OK once the handler returned, otherwise the reason it never ran. */
+    aparse_status status;
+
+    /** Index of the thread that ran the handler, 0 being the calling one. */
+    unsigned worker;
+} aparse_dispatch_result;
+
+/**
+ * @brief Dispatch all queued handlers on a pool of threads.
+ *
+ * Like ::aparse_dispatch_all, but independent handlers run concurrently.
+ * Every thread keeps its own queue of ready handlers and takes work from
+ * the others once it is empty. A handler becomes ready when all the
+ * handlers it depends on (see ::aparse_dispatch_dep) have returned.
+ *
+ * The payloads are released on the calling thread once every handler has
+ * returned, so allocators do not have to be thread-safe.
+ *
+ * @param dispatch_list The list of dispatched functions, freed on return.
+ * @param threads       Number of threads including the calling one, 0 or 1
+ *                      to run the handlers serially (capped at 64).
+ * @param deps          Ordering constraints, may be `NULL`.
+ * @param dep_count     Number of entries of @p deps.
+ * @param results       Optional output, one record per queued handler in
+ *                      queue order (`dispatch_list->size` entries).
+ *
+ * @return ::APARSE_STATUS_OK, ::APARSE_STATUS_FAILURE if @p deps contain a
+ *         cycle, or ::APARSE_STATUS_ALLOC_FAILURE. No handler runs in the
+ *         two latter cases.
+ *
+ * @note Handlers must be safe to run concurrently with each other.
+ * @note Built with `APARSE_NO_THREADS`, the handlers all run on the calling thread.
+ */
+extern aparse_status aparse_dispatch_parallel(
+        aparse_list* dispatch_list,
+        const unsigned threads,
+        const aparse_dispatch_dep* deps,
+        const size_t dep_count,
+        aparse_dispatch_result* results);
+
+/**
+ * @brief Outcome of one command line of ::aparse_parse_batch.
+ */
+typedef struct aparse_batch_result
+{
+    /** ::APARSE_STATUS_OK, or the first error the parse reported. */
+    aparse_status status;
+
+    /** Index in argv of the token at fault, -1 when there is none. */
+    int token;
+} aparse_batch_result;
+
+/**
+ * @brief Validate many command lines against one schema.
+ *
+ * Each input is parsed as by ::aparse_parse_ex, except that nothing is
+ * written to the destinations of the schema, no handler is dispatched and
+ * nothing is printed: errors only end up in @p results, and a help
+ * request fails at its token without printing. Each thread reuses one
+ * parser and one arena for all of its inputs, reset between them.
+ *
+ * @param schema  The compiled schema of the tool.
+ * @param count   Number of command lines.
+ * @param argcs   Argument count of each command line.
+ * @param argvs   Argument vector of each command line, `argv[0]` included.
+ * @param threads Number of threads to spread the inputs over, 0 or 1 for
+ *                the calling thread only. Contiguous ranges of inputs go
+ *                to each thread.
+ * @param results One record per command line, filled in order.
+ *
+ * @return ::APARSE_STATUS_OK when every command line parsed,
+ *         ::APARSE_STATUS_FAILURE when at least one did not, or
+ *         ::APARSE_STATUS_NULL_POINTER for a missing parameter.
+ *
+ * @note With several threads the default allocator (see
+ *       ::aparse_set_allocator) must be thread-safe, arenas grow from it.
+ *       Built with `APARSE_NO_THREADS`, every input is parsed on the
+ *       calling thread.
+ */
+aparse_status aparse_parse_batch(
+        const aparse_schema* schema,
+        const size_t count,
+        const int* argcs,
+        char* const* const* argvs,
+        const unsigned threads,
+        aparse_batch_result* results);
+
+/**
+ * @brief Convert a string to an integer of @p size bytes.
+ *
+ * This is the conversion used for ::APARSE_ARG_TYPE_UNSIGNED and
+ * ::APARSE_ARG_TYPE_SIGNED arguments. The string is an optional sign
+ * followed by digits in base 10, or in base 16 (`0x`), 2 (`0b`) or
+ * 8 (`0o` or a leading `0`). It is not affected by the current locale.
+ *
+ * @param str       Null-terminated string to convert.
+ * @param dest      Destination, written only on success.
+ * @param size      Destination width in bytes, from 1 to 8.
+ * @param is_signed Whether @p dest is a two's complement signed integer.
+ *
+ * @return ::APARSE_STATUS_OK, or
+ *         - ::APARSE_STATUS_INVALID_VALUE if @p str is not a number,
+ *         - ::APARSE_STATUS_OVERFLOW if it is above the range of @p size bytes,
+ *         - ::APARSE_STATUS_UNDERFLOW if it is below that range, including
+ *           any negative number when @p is_signed is false,
+ *         - ::APARSE_STATUS_UNHANDLED if @p size is larger than 8 bytes,
+ *         - ::APARSE_STATUS_INVALID_SIZE if @p size is 0.
+ */
+aparse_status aparse_convert_integer(
+        const char* str,
+        void* dest,
+        const size_t size,
+        const bool is_signed);
+
+/**
+ * @brief Convert a string to a floating-point number of @p size bytes.
+ *
+ * This is the conversion used for ::APARSE_ARG_TYPE_FLOAT arguments. The
+ * string is a decimal number with an optional sign, fraction and exponent
+ * (`-1.5e3`), or `inf`, `infinity` or `nan` in any case. `float` and
+ * `double` destinations are rounded correctly and independently of the
+ * current locale, `long double` ones are converted by `strtold`.
+ *
+ * @param str  Null-terminated string to convert.
+ * @param dest Destination, written only on success.
+ * @param size `sizeof(float)`, `sizeof(double)` or `sizeof(long double)`.
+ *
+ * @return ::APARSE_STATUS_OK, or
+ *         - ::APARSE_STATUS_INVALID_VALUE if @p str is not a number,
+ *         - ::APARSE_STATUS_OVERFLOW if it is too large for @p size bytes,
+ *         - ::APARSE_STATUS_UNDERFLOW if it is nonzero but rounds to zero
+ *           or to a subnormal,
+ *         - ::APARSE_STATUS_UNHANDLED for any other @p size.
+ */
+aparse_status aparse_convert_float(
+        const char* str,
+        void* dest,
+        const size_t size);
+
+/**
+ * @brief Convert @p count strings into a contiguous array.
+ *
+ * Equivalent to calling ::aparse_convert_integer or ::aparse_convert_float
+ * on each string in turn, but the type and width are checked once for the
+ * whole array. `int32_t`, `int64_t`, `float` and `double` elements (and
+ * their unsigned counterparts) have dedicated conversion loops, plain
+ * decimal integers are converted 8 digits at a time.
+ *
+ * @param strs      Strings to convert, such as a slice of `argv`.
+ * @param count     Number of strings.
+ * @param dest      Array of @p count elements of @p size bytes.
+ * @param size      Element width, as for the single conversions.
+ * @param type      ::APARSE_ARG_TYPE_UNSIGNED, ::APARSE_ARG_TYPE_SIGNED or
+ *                  ::APARSE_ARG_TYPE_FLOAT.
+ * @param converted Set to the number of elements converted, which is the
+ *                  index of the failing string on error. May be `NULL`.
+ *
+ * @return ::APARSE_STATUS_OK, the status of the first string that failed to
+ *         convert, or ::APARSE_STATUS_INVALID_TYPE for any other @p type.
+ *
+ * @note The conversion stops at the first failure, so a float ::APARSE_STATUS_UNDERFLOW
+ *       that an array argument tolerates must be skipped by calling again
+ *       from the next string.
+ */
+aparse_status aparse_convert_batch(
+        char* const* strs,
+        const size_t count,
+        void* dest,
+        const size_t size,
+        const aparse_arg_types type,
+        size_t* converted);
+
 /**
  * @brief Set a global error callback for parser events.
  *
@@ -0,0 +1,196 @@
+/*
+MIT License
+
+Copyright (c) 2025 binaryfox0
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef APARSE_ALLOC_H
+#define APARSE_ALLOC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief Memory allocator interface.
+ *
+ * Every function receives @ref userdata as its first parameter. Sizes are
+ * always passed back on release, so sized allocators do not have to keep
+ * their own headers.
+ *
+ * A `NULL` allocator pointer anywhere in the library stands for the
+ * default allocator (see ::aparse_set_allocator), which is the C library
+ * `malloc`/`realloc`/`free` unless replaced.
+ */
+typedef struct aparse_allocator
+{
+    /** Allocate @p size bytes, `NULL` on failure. */
+    void* (*alloc)(void* userdata, size_t size);
+
+    /** Resize a block of @p old_size bytes, `NULL` on failure (the block is kept). */
+    void* (*realloc)(void* userdata, void* ptr, size_t old_size, size_t new_size);
+
+    /** Release a block of @p size bytes. @p ptr may be `NULL`. */
+    void  (*free)(void* userdata, void* ptr, size_t size);
+
+    /** User-defined pointer forwarded to every function. */
+    void* userdata;
+} aparse_allocator;
+
+/**
+ * @brief Allocation counters of a single parse.
+ *
+ * Retrieved with ::aparse_parser_alloc_stats. A `realloc` counts as one
+ * allocation of the size difference when growing.
+ */
+typedef struct aparse_alloc_stats
+{
+    /** Number of allocations (including reallocations). */
+    size_t count;
+
+    /** Total bytes requested. */
+    size_t bytes;
+
+    /** Highest number of bytes live at once. */
+    size_t peak;
+} aparse_alloc_stats;
+
+/** @cond INTERNAL */
+typedef struct aparse__arena_block aparse__arena_block;
+/** @endcond */
+
+/**
+ * @brief Bump allocator for the allocations of one or more parses.
+ *
+ * The arena either carves allocations out of a caller-supplied buffer, or
+ * out of blocks it allocates itself. Individual frees are ignored (except
+ * for the most recent allocation), and everything is released at once by
+ * ::aparse_arena_reset.
+ *
+ * Initialize it with ::aparse_arena_init before use. The fields are only
+ * public so that an arena can live on the stack.
+ */
+typedef struct aparse_arena
+{
+    /** Allocator routing into this arena, see ::aparse_arena_allocator. */
+    aparse_allocator allocator;
+
+    /** @cond INTERNAL */
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t last; // offset of the most recent allocation
+
+    size_t block_size;
+    aparse__arena_block *head;
+    aparse__arena_block *current;
+    /** @endcond */
+} aparse_arena;
+
+/**
+ * @brief Initialize an arena.
+ *
+ * @param arena  The arena to initialize.
+ * @param buffer Caller-owned storage, or `NULL` to let the arena allocate
+ *               blocks of at least @p size bytes from the default
+ *               allocator as needed.
+ * @param size   Size of @p buffer, or the block size when @p buffer is `NULL`
+ *               (0 picks a default).
+ *
+ * @note An arena over a caller buffer never grows, allocations fail once
+ *       the buffer is exhausted.
+ */
+void aparse_arena_init(
+        aparse_arena* arena,
+        void* buffer,
+        const size_t size);
+
+/**
+ * @brief Allocate @p size bytes from the arena.
+ *
+ * The returned memory is aligned for any fundamental type.
+ *
+ * @return The allocation, or `NULL` if the arena is out of space.
+ */
+void* aparse_arena_alloc(
+        aparse_arena* arena,
+        const size_t size);
+
+/**
+ * @brief Release every allocation of the arena at once.
+ *
+ * Blocks allocated by the arena are kept for reuse, so the reset takes
+ * constant time.
+ */
+void aparse_arena_reset(aparse_arena* arena);
+
+/**
+ * @brief Free the blocks owned by the arena.
+ *
+ * The arena must be initialized again before it can be reused.
+ */
+void aparse_arena_destroy(aparse_arena* arena);
+
+/**
+ * @brief Allocator routing into @p arena.
+ * @return A pointer to the allocator embedded in @p arena.
+ */
+const aparse_allocator* aparse_arena_allocator(aparse_arena* arena);
+
+/**
+ * @brief Set the process-wide default allocator.
+ *
+ * Every `NULL` allocator pointer in the library resolves to this one:
+ * ::aparse_compile, ::aparse_parser_new, arena blocks, and parses of
+ * parsers without an allocator of their own.
+ *
+ * @param allocator The allocator to use, or `NULL` for the C library one.
+ *                  It is referenced, not copied.
+ *
+ * @warning Memory is released through the default allocator active at
+ *          release time, set it once before anything is allocated.
+ */
+void aparse_set_allocator(const aparse_allocator* allocator);
+
+/**
+ * @brief Allocate through @p allocator, or the default one when it is `NULL`.
+ */
+void* aparse_allocator_alloc(
+        const aparse_allocator* allocator,
+        const size_t size);
+
+/**
+ * @brief Resize through @p allocator, or the default one when it is `NULL`.
+ */
+void* aparse_allocator_realloc(
+        const aparse_allocator* allocator,
+        void* ptr,
+        const size_t old_size,
+        const size_t new_size);
+
+/**
+ * @brief Release through @p allocator, or the default one when it is `NULL`.
+ */
+void aparse_allocator_free(
+        const aparse_allocator* allocator,
+        void* ptr,
+        const size_t size);
+
+#endif
@@ -28,6 +28,8 @@ SOFTWARE.
 #include <stdint.h>
 #include <stddef.h>
 
+struct aparse_allocator;
+
 /**
  * @brief Dynamic array container.
  *
@@ -48,6 +50,13 @@ typedef struct aparse_list
 
     /** Size of each element in bytes. */
     size_t itemsz;
+
+    /**
+     * Allocator owning @ref ptr, `NULL` for the process-wide default set
+     * by ::aparse_set_allocator (the C library allocator unless replaced).
+     * Lists filled by the parser carry the allocator of that parse.
+     */
+    const struct aparse_allocator* allocator;
 } aparse_list;
 
 /**
@@ -113,7 +122,7 @@ int aparse_list_add(
 /**
  * @brief Releases all resources owned by the list.
  *
- * Frees the list's storage and resets its fields.
+ * Frees the list's storage through its allocator and resets its fields.
  *
  * @param list List to free.
  */
@@ -38,7 +38,7 @@ REPO_DIR = (Path(__file__).resolve().parent / "..").resolve()
 HEADER_DIR = REPO_DIR / "include"
 HEADER_ENTRY = "aparse.h"
 SOURCE_DIR = REPO_DIR / "src"
-SOURCES = [ "aparse_list.c", "aparse.c" ]
+SOURCES = [ "aparse_alloc.c", "aparse_list.c", "aparse_convert.c", "aparse.c" ]
 
 def get_git_commit():
     try:
@@ -127,7 +127,7 @@ def emit_implementation(dest: TextIO, path: Path):
                         in_comment = True
                     continue
 
-            if not skipped_guard:
+            if not skipped_guard and not after_includes:
                 if pending_ifndef and stripped.startswith("#define"):
                     skipped_guard = True
                     continue
@@ -0,0 +1,384 @@
+#!/usr/bin/env python3
+"""
+Generate static aparse schemas from a declarative JSON description.
+
+The output contains the aparse_arg tables, the subcommand data layouts and
+a minimal perfect hash for the option names of every parser level and the
+subcommand names of every parser argument. The emitted `aparse_schema` can
+be passed to aparse_parse_schema() directly, no index is built at startup.
+
+Schema format:
+
+    {
+        "name": "tool",                    C identifier prefix
+        "includes": ["tool.h"],            headers declaring dests/handlers
+        "args": [ARG, ...]
+    }
+
+    ARG is one of (every C expression is given as a string):
+    { "kind": "option", "short": "-v", "long": "--verbose",
+      "dest": "&verbose", "size": "sizeof(verbose)", "type": "BOOL" }
+    { "kind": "number", "name": "count", "dest": "&count",
+      "size": "sizeof(count)", "type": "SIGNED" }
+    { "kind": "string", "name": "file", "dest": "&file", "size": "0" }
+    { "kind": "string", "name": "query", "dest": "&query",
+      "size": "sizeof(aparse_string_view)", "type": "STRING_VIEW" }
+    { "kind": "array", "name": "points", "dest": "&points",
+      "size": "sizeof(aparse_list)", "count": "0", "max": "16",
+      "type": "FLOAT", "element_size": "sizeof(double)" }
+    { "kind": "stream", "name": "values", "dest": "&values_stream",
+      "type": "UNSIGNED", "element_size": "sizeof(uint32_t)" }
+    { "kind": "parser", "name": "command", "subcommands": [
+        { "name": "add", "handler": "add_command", "buffer": "NULL",
+          "size": "0", "struct": "add_payload_t", "members": ["a", "b"],
+          "args": [ARG, ...] }
+    ] }
+
+    Every ARG also accepts an optional "help" string, options and numbers
+    or strings an optional "env" variable name. The "count" of an array is
+    the least number of values it takes, "max" the most (0 or left out for
+    no bound), as for aparse_arg_array_n(). The "dest" of a stream is an
+    aparse_stream, as for aparse_arg_stream().
+"""
+
+import argparse
+import json
+from pathlib import Path
+
+FNV_OFFSET = 2166136261
+FNV_PRIME = 16777619
+U32 = 0xFFFFFFFF
+MAX_DISPLACEMENT = 1 << 20
+
+TYPES = {
+    "STRING": "APARSE_ARG_TYPE_STRING",
+    "BOOL": "APARSE_ARG_TYPE_BOOL",
+    "UNSIGNED": "APARSE_ARG_TYPE_UNSIGNED",
+    "SIGNED": "APARSE_ARG_TYPE_SIGNED",
+    "FLOAT": "APARSE_ARG_TYPE_FLOAT",
+    "STRING_VIEW": "APARSE_ARG_TYPE_STRING_VIEW",
+}
+
+# Keep in sync with aparse__hash_name() and aparse__hash_mix() in src/aparse.c
+def hash_name(name: str) -> int:
+    h = FNV_OFFSET
+    for byte in name.encode("utf-8"):
+        if byte == ord("="):
+            break
+        h ^= byte
+        h = (h * FNV_PRIME) & U32
+    return h
+
+def hash_mix(h: int) -> int:
+    h ^= h >> 16
+    h = (h * 0x85EBCA6B) & U32
+    h ^= h >> 13
+    h = (h * 0xC2B2AE35) & U32
+    h ^= h >> 16
+    return h
+
+def build_mph(keys):
+    """keys: list of (name, entry). Returns (displace, index) or None."""
+    if not keys:
+        return None
+
+    size = len(keys)
+    buckets = [[] for _ in range(size)]
+    for name, entry in keys:
+        h = hash_name(name)
+        buckets[h % size].append((h, name, entry))
+
+    displace = [0] * size
+    index = [0] * size
+    used = [False] * size
+    order = sorted(range(size), key=lambda b: len(buckets[b]), reverse=True)
+    for bucket in order:
+        items = buckets[bucket]
+        if not items:
+            break
+        for d in range(MAX_DISPLACEMENT):
+            slots = [hash_mix(h ^ d) % size for h, _, _ in items]
+            if len(set(slots)) == len(slots) and \
+                    not any(used[s] for s in slots):
+                break
+        else:
+            names = ", ".join(name for _, name, _ in items)
+            raise SystemExit(f"error: unable to build perfect hash for: {names}")
+
+        displace[bucket] = d
+        for slot, (_, _, entry) in zip(slots, items):
+            used[slot] = True
+            index[slot] = entry
+    return displace, index
+
+def c_string(value):
+    if value is None:
+        return "NULL"
+    escaped = (str(value)
+               .replace("\\", "\\\\")
+               .replace('"', '\\"')
+               .replace("\n", "\\n")
+               .replace("\t", "\\t"))
+    return f'"{escaped}"'
+
+def c_expr(value, default="0"):
+    if value is None:
+        return default
+    return str(value)
+
+def c_type(arg, extra):
+    base = TYPES.get(str(arg.get("type", "STRING")).upper())
+    if base is None:
+        raise SystemExit(f"error: unknown type '{arg.get('type')}' of '{arg_name(arg)}'")
+    return " | ".join([base] + extra)
+
+def arg_name(arg):
+    return arg.get("name") or arg.get("long") or arg.get("short") or "?"
+
+def u32_array(values):
+    return ", ".join(str(v) for v in values)
+
+class Generator:
+    def __init__(self, prefix: str):
+        self.prefix = prefix
+        self.counter = 0
+        self.out = []
+
+    def ident(self, kind, number):
+        return f"{self.prefix}_{kind}_{number}"
+
+    def emit(self, line=""):
+        self.out.append(line)
+
+    def emit_table(self, ctype, name, values):
+        if not values:
+            return "NULL"
+        self.emit(f"static const {ctype} {name}[] = {{ {u32_array(values)} }};")
+        return name
+
+    def emit_node(self, number, fields):
+        self.emit(f"static const aparse_schema_node {self.ident('node', number)} = {{")
+        for key, value in fields:
+            self.emit(f"    .{key} = {value},")
+        self.emit("};")
+        self.emit()
+        return "&" + self.ident("node", number)
+
+    def emit_level(self, args):
+        """Emits a parser level, returns (args array, node address)."""
+        number = self.counter
+        self.counter += 1
+
+        entries, children, keys, positionals, envs = [], [], [], [], []
+        for i, arg in enumerate(args):
+            kind = arg.get("kind")
+            help_str = c_string(arg.get("help"))
+            child = "NULL"
+            if kind == "option":
+                fields = [
+                    ("shortopt", c_string(arg.get("short"))),
+                    ("longopt", c_string(arg.get("long"))),
+                    ("type", c_type(arg, ["APARSE_ARG_TYPE_ARGUMENT"])),
+                    ("ptr", c_expr(arg.get("dest"), "NULL")),
+                    ("size", c_expr(arg.get("size"))),
+                ]
+                for is_short, key in ((1, "short"), (0, "long")):
+                    name = arg.get(key)
+                    if name and all(name != k for k, _ in keys):
+                        keys.append((name, ((i << 1) | is_short) + 1))
+            elif kind in ("number", "string"):
+                extra = ["APARSE_ARG_TYPE_POSITIONAL", "APARSE_ARG_TYPE_ARGUMENT"]
+                if kind == "string" and str(arg.get("type")).upper() != "STRING_VIEW":
+                    arg = dict(arg, type="STRING")
+                fields = [
+                    ("longopt", c_string(arg["name"])),
+                    ("type", c_type(arg, extra)),
+                    ("ptr", c_expr(arg.get("dest"), "NULL")),
+                    ("size", c_expr(arg.get("size"))),
+                ]
+                positionals.append(i)
+            elif kind == "array":
+                extra = ["APARSE_ARG_TYPE_ARGUMENT", "APARSE_ARG_TYPE_ARRAY",
+                         "APARSE_ARG_TYPE_POSITIONAL"]
+                fields = [
+                    ("longopt", c_string(arg["name"])),
+                    ("type", c_type(arg, extra)),
+                    ("ptr", c_expr(arg.get("dest"), "NULL")),
+                    ("size", c_expr(arg.get("size"))),
+                    ("array_size", c_expr(arg.get("count"))),
+                    ("array_max", c_expr(arg.get("max"))),
+                    ("element_size", c_expr(arg.get("element_size"))),
+                ]
+                positionals.append(i)
+            elif kind == "stream":
+                extra = ["APARSE_ARG_TYPE_ARGUMENT", "APARSE_ARG_TYPE_ARRAY",
+                         "APARSE_ARG_TYPE_STREAM", "APARSE_ARG_TYPE_POSITIONAL"]
+                fields = [
+                    ("longopt", c_string(arg["name"])),
+                    ("type", c_type(arg, extra)),
+                    ("ptr", c_expr(arg.get("dest"), "NULL")),
+                    ("size", "sizeof(aparse_stream)"),
+                    ("element_size", c_expr(arg.get("element_size"))),
+                ]
+                positionals.append(i)
+            elif kind == "parser":
+                subargs, child = self.emit_subcommands(arg.get("subcommands", []))
+                fields = [
+                    ("longopt", c_string(arg["name"])),
+                    ("type", "APARSE_ARG_TYPE_POSITIONAL"),
+                    ("subargs", subargs),
+                ]
+                positionals.append(i)
+            else:
+                raise SystemExit(f"error: unknown kind '{kind}' of '{arg_name(arg)}'")
+
+            fields.append(("help", help_str))
+            if arg.get("env") and kind in ("option", "number", "string"):
+                fields.append(("env", c_string(arg["env"])))
+                envs.append(i)
+            entries.append(fields)
+            children.append(child)
+
+        node = self.emit_node_tables(number, entries, children, keys, positionals, envs)
+        return self.ident("args", number), node
+
+    def emit_subcommands(self, subcommands):
+        """Emits a subcommand list, returns (args array, node address)."""
+        number = self.counter
+        self.counter += 1
+
+        entries, children, keys, positionals = [], [], [], []
+        for i, sub in enumerate(subcommands):
+            child = "NULL"
+            subargs = "NULL"
+            layout, layout_size = "NULL", "0"
+            if sub.get("args"):
+                subargs, child = self.emit_level(sub["args"])
+            members = sub.get("members", [])
+            if members:
+                struct = sub["struct"]
+                layout = self.ident("layout", f"{number}_{i}")
+                pairs = ", ".join(
+                        f"offsetof({struct}, {m}), sizeof((({struct}*)0)->{m})"
+                        for m in members)
+                self.emit(f"static const size_t {layout}[] = {{ {pairs} }};")
+                self.emit()
+                layout_size = str(len(members))
+
+            entries.append([
+                ("longopt", c_string(sub["name"])),
+                ("type", "APARSE_ARG_TYPE_SUBPARSER"),
+                ("subargs", subargs),
+                ("handler", c_expr(sub.get("handler"), "NULL")),
+                ("data_layout", layout),
+                ("layout_size", layout_size),
+                ("ptr", c_expr(sub.get("buffer"), "NULL")),
+                ("size", c_expr(sub.get("size"))),
+                ("help", c_string(sub.get("help"))),
+            ])
+            children.append(child)
+            positionals.append(i)
+            if all(sub["name"] != k for k, _ in keys):
+                keys.append((sub["name"], (i << 1) + 1))
+
+        node = self.emit_node_tables(number, entries, children, keys, positionals)
+        return self.ident("args", number), node
+
+    def emit_node_tables(self, number, entries, children, keys, positionals, envs=()):
+        args = self.ident("args", number)
+        self.emit(f"static const aparse_arg {args}[] = {{")
+        for fields in entries:
+            self.emit("    {")
+            for key, value in fields:
+                self.emit(f"        .{key} = {value},")
+            self.emit("    },")
+        self.emit("    {0}")
+        self.emit("};")
+
+        mph = build_mph(keys)
+        index, displace, size = "NULL", "NULL", 0
+        if mph:
+            size = len(mph[1])
+            displace = self.emit_table("uint32_t", self.ident("displace", number), mph[0])
+            index = self.emit_table("uint32_t", self.ident("index", number), mph[1])
+        pos = self.emit_table("uint32_t", self.ident("positionals", number), positionals)
+        env = self.emit_table("uint32_t", self.ident("envs", number), envs)
+
+        child_table = self.ident("children", number)
+        self.emit(f"static const aparse_schema_node *const {child_table}[] = {{")
+        for child in children:
+            self.emit(f"    {child},")
+        self.emit("    NULL")
+        self.emit("};")
+
+        return self.emit_node(number, [
+            ("args", args),
+            ("count", str(len(entries))),
+            ("index", index),
+            ("index_size", str(size)),
+            ("displace", displace),
+            ("displace_size", str(size)),
+            ("positionals", pos),
+            ("positional_count", str(len(positionals))),
+            ("children", child_table),
+            ("envs", env),
+            ("env_count", str(len(envs))),
+        ])
+
+def generate(schema, source_name):
+    prefix = schema.get("name", "aparse_generated")
+    gen = Generator(prefix)
+    _, root = gen.emit_level(schema.get("args", []))
+
+    lines = [
+        f"/* Generated by script/schema_gen.py from {source_name}, do not edit. */",
+        "",
+        "#include <stddef.h>",
+        "#include <stdint.h>",
+        "",
+        "#include <aparse.h>",
+    ]
+    lines += [f'#include "{inc}"' for inc in schema.get("includes", [])]
+    lines += [""]
+    lines += gen.out
+    lines += [f"const aparse_schema {prefix}_schema = {{ .root = {root} }};", ""]
+    return "\n".join(lines)
+
+def generate_header(schema, guard):
+    prefix = schema.get("name", "aparse_generated")
+    return "\n".join([
+        "/* Generated by script/schema_gen.py, do not edit. */",
+        "",
+        f"#ifndef {guard}",
+        f"#define {guard}",
+        "",
+        "#include <aparse.h>",
+        "",
+        f"extern const aparse_schema {prefix}_schema;",
+        "",
+        f"#endif /* {guard} */",
+        "",
+    ])
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("schema", type=str, help="Path to the JSON schema")
+    parser.add_argument(
+            "-o", "--output",
+            type=str, required=True,
+            help="Path to the generated C source")
+    parser.add_argument(
+            "--header",
+            type=str, default=None,
+            help="Optional path to a header declaring the schema")
+    args = parser.parse_args()
+
+    source = Path(args.schema)
+    with source.open("r", encoding="utf-8") as f:
+        schema = json.load(f)
+
+    Path(args.output).write_text(generate(schema, source.name), encoding="utf-8")
+    if args.header:
+        header = Path(args.header)
+        guard = "".join(c if c.isalnum() else "_" for c in header.name).upper()
+        header.write_text(generate_header(schema, guard), encoding="utf-8")
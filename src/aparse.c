@@ -29,24 +29,47 @@ SOFTWARE.
 #include <stdlib.h>
 #include <stdio.h>
 #include <ctype.h>
-
 #include <errno.h>
-#include <limits.h>
-#include <math.h>
-#include <float.h>
 
 #ifdef _WIN32
 #   include <windows.h>
 #else
 #   include <unistd.h>
 #   include <sys/ioctl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <fcntl.h>
+#   ifndef APARSE_NO_THREADS
+#       include <pthread.h>
+#   endif
+#endif
+#ifdef _WIN32
+#   define aparse__environ _environ
+#else
+extern char **environ;
+#   define aparse__environ environ
+#endif
+#ifdef APARSE_STATS
+#   include <time.h>
+#   ifdef _MSC_VER
+#       include <intrin.h>
+#   endif
 #endif
 
 #define APARSE__SPACE_PER_INDENT 2 // indent/space
 #define MAX_ARG_STR 19
 #define APARSE__MAX_DEPTH 16
-
-// aparse_arg flags
+#define APARSE__INLINE_SLOTS 64
+#define APARSE__INLINE_LIST 16 // entries of each list without allocation
+#define APARSE__MAX_THREADS 64
+#define APARSE__THREAD_THRESHOLD 4096 // default minimum of parallel arrays
+#define APARSE__MAX_RESPONSE_FILES 32 // per parse, bounds nesting as well
+#define APARSE__STREAM_CHUNK 4096 // converted values of a stream without buffer
+#define APARSE__STREAM_INPUT 16384 // stdin read buffer, bounds the value length
+#define APARSE__STREAM_TOKENS 64
+#define APARSE__RENDER_CHUNK 4096 // help text rendered before touching the heap
+
+// Per-parse argument flags (aparse__slot_t.flags)
 // optional  | has_equal   APARSE_ARG_EQUAL_VAL
 // optional  | short_match APARSE_ARG_SHORT_MATCH
 // reserved  | 
@@ -74,39 +97,300 @@ SOFTWARE.
             __aparse_error_label ": "fmt "\n", ##__VA_ARGS__)
 #define aparse__raise_fatal(ctx, type, field1, field2) \
     { \
-        aparse__err_callback((ctx), (type), (field1), (field2), aparse__err_userdata); \
+        (ctx)->parser->err_callback((ctx), (type), (field1), (field2), \
+                (ctx)->parser->err_userdata); \
         return APARSE_STATUS_FAILURE; \
     }
 
 #define aparse__raise_nonfatal(ctx, type, field1, field2) \
-        aparse__err_callback((ctx), (type), (field1), (field2), aparse__err_userdata);
+        (ctx)->parser->err_callback((ctx), (type), (field1), (field2), \
+                (ctx)->parser->err_userdata);
 
 #define aparse__foreach(child, parent) \
-    for(aparse_arg *child = parent->subargs; aparse_arg_nend(child); child++)
+    for(const aparse_arg *child = parent->subargs; aparse_arg_nend(child); child++)
 #define aparse__tillend(element, start) \
-    for(aparse_arg *element = start; aparse_arg_nend(element); element++)
+    for(const aparse_arg *element = start; aparse_arg_nend(element); element++)
+
+// Phase probes of aparse_parser_stats, nothing is left of them without
+// APARSE_STATS. Ticks are TSC cycles where reading it is one instruction,
+// converted with the ratio measured over the whole parse.
+#ifdef APARSE_STATS
+#   if (defined(__GNUC__) || defined(__clang__)) && \
+        (defined(__x86_64__) || defined(__i386__))
+#       define aparse__ticks() ((uint64_t)__builtin_ia32_rdtsc())
+#   elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#       define aparse__ticks() ((uint64_t)__rdtsc())
+#   else
+#       define APARSE__TICKS_NS
+#       define aparse__ticks() aparse__clock_ns()
+#   endif
+#   define aparse__probe_begin(name) const uint64_t name = aparse__ticks()
+#   define aparse__probe_end(ctx, phase, name) \
+        ((ctx)->phases[phase] += aparse__ticks() - (name))
+#   define aparse__probe_match(ctx, arg) ((ctx)->matches += (arg) != NULL)
+#   define aparse__probe_start(ctx) \
+        ((ctx)->start_ns = aparse__clock_ns(), (ctx)->start_ticks = aparse__ticks())
+#   define aparse__probe_finish(ctx) aparse__stats_finish(ctx)
+#else
+#   define aparse__probe_begin(name) ((void)0)
+#   define aparse__probe_end(ctx, phase, name) ((void)0)
+#   define aparse__probe_match(ctx, arg) ((void)0)
+#   define aparse__probe_start(ctx) ((void)0)
+#   define aparse__probe_finish(ctx) ((void)0)
+#endif
 
 typedef enum {
     APARSE__ARG_EQUAL_VAL   = (1 << 0),
     APARSE__ARG_SHORT_MATCH = (1 << 1),
+    APARSE__ARG_GIVEN       = (1 << 2), // matched in argv, the environment is not read
     APARSE__ARG_PROCESSED   = (1 << 7)
 } aparse_arg_state_t;
 
+typedef enum {
+    APARSE__PHASE_MATCH,
+    APARSE__PHASE_CONVERT,
+    APARSE__PHASE_LAYOUT,
+    APARSE__PHASE_ALLOC,
+    APARSE__PHASE_MISSING,
+    APARSE__PHASE_DISPATCH,
+    APARSE__PHASE_COUNT
+} aparse__phase_t;
+
 
 typedef struct {
-    aparse_arg* args;
+    const aparse_arg* args;
     void* payload;
+    size_t payload_size; // non-zero when the payload is owned by the list
 } aparse__dispatch_t;
 
+typedef aparse_schema_node aparse__node_t;
+
+// Parse state of a single argument, the schema itself is never written.
+// Only current when stamp matches its level, see aparse__level_slot.
+typedef struct {
+    uint64_t stamp;
+    uint8_t flags;
+    // Resolved destination, either aparse_arg.ptr or inside the payload
+    void *ptr;
+    size_t size;
+} aparse__slot_t;
+
+// Value of a lazy argument, converted into arg->ptr on first access
+typedef struct {
+    const aparse_arg *arg;
+    const char *value;
+    aparse_status status;
+    bool converted;
+} aparse__deferred_t;
+
+typedef struct {
+    const aparse_arg *args;
+    const aparse__node_t *node;
+    aparse__slot_t *slots;
+    size_t count;
+    uint64_t stamp; // new for every push, never 0
+} aparse__level_t;
+
+// Streaming array in progress, values wait in buffer until it is full
+typedef struct {
+    const aparse_arg *arg;
+    const aparse_stream *desc;
+    uint8_t *buffer;
+    size_t batch;
+    size_t filled;
+    size_t increment;
+} aparse__stream_t;
+
+// Help or usage text being rendered. A growable render starts in chunk and
+// is written to stdout at once by aparse__render_flush, otherwise the text
+// goes to a caller buffer and is truncated there.
+typedef struct {
+    char *ptr;
+    size_t size;
+    size_t capacity;
+    size_t length; // of the whole text, beyond size once truncated
+    char *chunk;
+    const aparse_allocator *alloc; // NULL for a caller buffer
+    bool growable;
+    int width; // terminal width, looked up once per render
+} aparse__render_t;
+
+// A response file, tokens are packed at the start of base
+typedef struct {
+    char *base;
+    size_t size;
+    bool mapped;
+    bool owned; // a copy from the default allocator, otherwise from the region
+} aparse__response_t;
+
+struct aparse_parser
+{
+    const aparse_schema *schema;
+    const aparse_arg *args; // for uncompiled tables, when schema is NULL
+    const char *desc;
+    const char *progname;
+
+    aparse_error_callback err_callback;
+    void *err_userdata;
+
+    const aparse_allocator *allocator; // NULL for the default allocator
+    aparse_alloc_stats stats; // of the last parse
+#ifdef APARSE_STATS
+    aparse_stats phase_stats;
+#endif
+
+    // aparse_parser_set_no_alloc, allocator then points to region
+    bool no_alloc;
+    aparse_arena region;
+
+    // aparse_parser_set_threads, arrays are converted serially below 2 threads
+    unsigned threads;
+    size_t thread_threshold;
+
+    // aparse_parser_set_response_files, files stay loaded until the next parse
+    bool response_files;
+    aparse__response_t responses[APARSE__MAX_RESPONSE_FILES];
+    size_t response_count;
+
+    // aparse_parse_batch, values go to scratch and nothing is printed
+    bool batch;
+
+    // aparse_parser_set_lazy, numbers matched by the last parse that are
+    // only converted by the aparse_get_* functions
+    bool lazy;
+    aparse__deferred_t *deferred;
+    size_t deferred_count;
+    size_t deferred_capacity;
+
+    // Slots outlive the parse and are reset by stamping levels instead.
+    // Levels beyond the inline slots take them from slot_cache, grown
+    // from the allocator at the start of a parse to what the last one
+    // wanted. Only when keep_storage: memory of an arena or a no-alloc
+    // region does not survive until the next parse.
+    uint64_t stamp;
+    aparse__slot_t inline_slots[APARSE__INLINE_SLOTS];
+    bool keep_storage;
+    aparse__slot_t *slot_cache;
+    size_t slot_cache_size;
+    size_t slot_cache_wanted;
+};
+
+#ifndef APARSE_NO_THREADS
+typedef struct {
+#   ifdef _WIN32
+    HANDLE handle;
+#   else
+    pthread_t handle;
+#   endif
+    void (*fn)(void*);
+    void *userdata;
+} aparse__thread_t;
+
+#   ifdef _WIN32
+typedef SRWLOCK aparse__mutex_t;
+typedef CONDITION_VARIABLE aparse__cond_t;
+#   else
+typedef pthread_mutex_t aparse__mutex_t;
+typedef pthread_cond_t aparse__cond_t;
+#   endif
+#else
+typedef int aparse__mutex_t; // a single thread, nothing to guard
+typedef int aparse__cond_t;
+#endif
+
+typedef struct aparse__pool aparse__pool_t;
+
+// Thread of aparse_dispatch_parallel with its deque of ready entries, the
+// owner works from the bottom while the others steal from the top
+typedef struct {
+    aparse__pool_t *pool;
+    unsigned id;
+    aparse__mutex_t lock;
+    size_t *items;
+    size_t top, bottom;
+#ifndef APARSE_NO_THREADS
+    aparse__thread_t thread;
+#endif
+} aparse__worker_t;
+
+struct aparse__pool {
+    aparse__dispatch_t *entries;
+    size_t count;
+    size_t *pending; // unfinished dependencies of each entry
+    size_t *first; // dependents of entry i are dependents[first[i]..first[i + 1]]
+    size_t *dependents;
+    aparse__worker_t *workers;
+    unsigned worker_count;
+    aparse_dispatch_result *results;
+
+    aparse__mutex_t lock; // guards pending, remaining and pushes
+    aparse__cond_t wake;
+    size_t remaining;
+    size_t pushes; // entries made ready so far, wakes idle workers up
+};
+
+// One chunk of an array converted by aparse__convert_parallel
+typedef struct {
+    const aparse_arg *arg;
+    char* const *argv;
+    uint8_t *dest;
+    size_t count;
+    size_t increment;
+    size_t failed; // index of the first fatal error, count if none
+    size_t underflows;
+    aparse_status status;
+} aparse__convert_task_t;
+
+// A range of aparse_parse_batch inputs, parsed by one thread
+typedef struct {
+    const aparse_schema *schema;
+    const int *argcs;
+    char* const* const* argvs;
+    aparse_batch_result *results;
+    size_t count;
+    size_t failed;
+} aparse__batch_task_t;
+
 typedef struct aparse_context
 {
+    aparse_parser *parser;
+    // Every allocation of the parse goes through alloc, which counts
+    // and forwards to backing. Memory escaping the parse gets backing.
+    const aparse_allocator *alloc;
+    const aparse_allocator *backing;
+    aparse_allocator counter;
+    aparse_alloc_stats stats;
+    size_t live;
+#ifdef APARSE_STATS
+    // Raw ticks per aparse__phase_t, turned into aparse_stats at the end
+    uint64_t phases[APARSE__PHASE_COUNT];
+    uint64_t start_ticks;
+    uint64_t start_ns;
+    size_t matches;
+#endif
+    // Token table, argv with the response files reached so far spliced in
+    char* const *argv;
+    int argc;
+    char **tokens; // owned copy of argv, tokens_size entries
+    size_t tokens_size;
+    // environ by variable name, built on the first env lookup
+    const char **env_index;
+    size_t env_size;
+    bool env_scanned;
     int idx;
     aparse_list *unknown;
     aparse_list *dispatch;
-    int layer_idx;
 
-    aparse_arg *stack[APARSE__MAX_DEPTH];
+    aparse__level_t stack[APARSE__MAX_DEPTH];
     int stack_top;
+
+    // Slots of the parser taken by the levels pushed so far
+    size_t inline_used;
+    size_t cache_used;
+
+    // Fixed storage of the unknown/dispatch lists in no-alloc mode
+    const char *inline_unknown[APARSE__INLINE_LIST];
+    aparse__dispatch_t inline_dispatch[APARSE__INLINE_LIST];
 } aparse__context_t;
 
 APARSE_INLINE bool aparse__is_positional(
@@ -124,8 +408,32 @@ static inline bool aparse__type_cmp(
     return (arg->type & APARSE_ARG_TYPE_BITMASK) == type;
 }
 
+// The slot of level->args[index], a stale one (of an earlier level or
+// parse) starts over from the schema on first use
+static inline aparse__slot_t* aparse__level_slot(
+        const aparse__level_t* level,
+        const size_t index) {
+    aparse__slot_t *slot = &level->slots[index];
+    if(slot->stamp != level->stamp)
+    {
+        *slot = (aparse__slot_t){
+            .stamp = level->stamp,
+            .ptr = level->args[index].ptr,
+            .size = level->args[index].size
+        };
+    }
+    return slot;
+}
+
+// A compiled node and its children, positionals and envs tables,
+// allocated as one block
+static inline size_t aparse__node_block_size(
+        const size_t count) {
+    return sizeof(aparse__node_t) + 
+        count * (sizeof(aparse__node_t*) + 2 * sizeof(uint32_t));
+}
+
 const char* __aparse_progname = 0;
-static const char *aparse__desc = 0;
 
 static const aparse_arg aparse__help_arg = 
 { 
@@ -134,48 +442,204 @@ static const aparse_arg aparse__help_arg =
     .help = "show this help message and exit", 
     .type = APARSE_ARG_TYPE_BOOL 
 };
+// Defaults for aparse_parse/aparse_parse_schema and new parsers
 static aparse_error_callback aparse__err_callback = 0;
 static void* aparse__err_userdata = 0;
 
 // Forward declaration
-static aparse_status aparse__parse_impl(
+static aparse_status aparse__parse_root(
+        aparse_parser* parser,
         const int argc, 
-        char * const * argv, 
-        aparse_arg* args, 
-        aparse__context_t* ctx
-);
+        char* const * argv,
+        aparse_list* dispatch_list_out);
+
+static aparse_status aparse__parse_impl(
+        aparse__context_t* ctx);
+
+static aparse_status aparse__push_level(
+        aparse__context_t* ctx,
+        const aparse_arg* args,
+        const aparse__node_t* node);
+
+static void aparse__pop_level(
+        aparse__context_t* ctx);
+
+static void aparse__reserve_slots(
+        aparse__context_t* ctx);
+
+static void aparse__release_storage(
+        aparse_parser* parser);
+
+static aparse_status aparse__defer_argument(
+        aparse__context_t* ctx,
+        const aparse_arg* arg,
+        const char* argv);
+
+static aparse_status aparse__get_number(
+        aparse_parser* parser,
+        const aparse_arg* arg,
+        const aparse_arg_types type,
+        void* value);
 
 // Processing each type of argument
+static aparse_status aparse__convert_element(
+        const aparse_arg* arg,
+        const char* argv,
+        void* dest,
+        const size_t size);
+
+static aparse_status aparse__convert_elements(
+        const aparse_arg* arg,
+        char* const* argv,
+        uint8_t* dest,
+        const size_t count,
+        const size_t increment,
+        size_t* converted);
+
+static aparse_status aparse__raise_conversion(
+        aparse__context_t* ctx,
+        const aparse_arg* arg,
+        const char* argv,
+        const aparse_status status);
+
 static aparse_status aparse__process_argument(
         const char* argv, 
         const aparse_arg* arg,
+        void* dest,
+        const size_t size,
         aparse__context_t *ctx);
 
 static aparse_status aparse__process_parser(
-        const int argc, 
         const char* cargv, 
-        char* const* argv, 
-        aparse_arg* arg, 
+        const aparse_arg* arg, 
+        const aparse__node_t* choices,
         aparse__context_t* ctx
 );
 
 static aparse_status aparse_process_optional(
-        const int argc, 
-        char* const* argv, 
-        aparse_arg* arg,
+        const aparse_arg* arg,
         aparse__context_t *ctx
 );
 // Processing each data type
-static aparse_status aparse__process_float(
-        const char* argv, 
-        const aparse_arg* arg);
-
 static aparse_status aparse__process_array(
-        const int argc, 
-        char* const* argv, 
-        aparse_arg* arg, 
+        const aparse_arg* arg, 
+        aparse__context_t *ctx);
+
+static aparse_status aparse__array_extent(
+        const aparse_arg* arg,
+        aparse__context_t *ctx,
+        size_t* count);
+
+static aparse_status aparse__process_stream(
+        const aparse_arg* arg,
+        const aparse_stream* desc,
+        char* const* argv,
+        const size_t count,
+        const size_t increment,
+        aparse__context_t *ctx);
+
+static aparse_status aparse__stream_push(
+        aparse__context_t* ctx,
+        aparse__stream_t* stream,
+        char* const* tokens,
+        const size_t count);
+
+static bool aparse__stream_flush(
+        aparse__stream_t* stream);
+
+static bool aparse__stream_discard(
+        const aparse_arg* arg, 
+        const void* values, 
+        size_t count, 
+        void* userdata);
+
+static aparse_status aparse__stream_stdin(
+        aparse__context_t* ctx,
+        aparse__stream_t* stream);
+
+static void aparse__convert_task_run(
+        void* userdata);
+
+static aparse_status aparse__convert_parallel(
+        const aparse_arg* arg,
+        char* const* argv,
+        uint8_t* dest,
+        const size_t count,
+        const size_t increment,
+        size_t* converted,
         aparse__context_t *ctx);
 
+#ifndef APARSE_NO_THREADS
+static bool aparse__thread_start(
+        aparse__thread_t* thread,
+        void (*fn)(void*),
+        void* userdata);
+
+static void aparse__thread_join(
+        aparse__thread_t* thread);
+#endif
+
+// Batch parsing
+static void aparse__batch_task_run(
+        void* userdata);
+
+static void aparse__batch_errcb(
+        const aparse_context* ctx,
+        const aparse_status status, 
+        const void* field1, 
+        const void* field2, 
+        void* userdata);
+
+static void aparse__mutex_init(aparse__mutex_t* mutex);
+static void aparse__mutex_destroy(aparse__mutex_t* mutex);
+static void aparse__mutex_lock(aparse__mutex_t* mutex);
+static void aparse__mutex_unlock(aparse__mutex_t* mutex);
+static void aparse__cond_init(aparse__cond_t* cond);
+static void aparse__cond_destroy(aparse__cond_t* cond);
+static void aparse__cond_wait(aparse__cond_t* cond, aparse__mutex_t* mutex);
+static void aparse__cond_broadcast(aparse__cond_t* cond);
+
+// Parallel dispatch
+static size_t aparse__pool_edges(
+        const aparse__pool_t* pool,
+        const aparse_dispatch_dep* deps,
+        const size_t dep_count,
+        size_t* pairs);
+
+static bool aparse__pool_build(
+        aparse__pool_t* pool,
+        const size_t* pairs,
+        const size_t edges,
+        size_t* scratch);
+
+static void aparse__pool_run(
+        void* userdata);
+
+static bool aparse__pool_take(
+        aparse__worker_t* self,
+        size_t* index);
+
+static void aparse__pool_finish(
+        aparse__worker_t* self,
+        const size_t index);
+
+// Response files
+static aparse_status aparse__expand_response(
+        aparse__context_t* ctx,
+        const int index);
+
+static bool aparse__load_response(
+        aparse__context_t* ctx,
+        const char* path,
+        aparse__response_t* response);
+
+static size_t aparse__tokenize(
+        char* buffer,
+        const size_t size);
+
+static void aparse__release_responses(
+        aparse_parser* parser);
+
 // For aparse_arg is subparsers and have proper data_layout & layout_size
 static size_t aparse__eval_size(
         const aparse_arg* arg);
@@ -184,17 +648,49 @@ static bool aparse__verify_layout(
         const aparse_arg *arg, 
         int *invalid_idx);
 
-static int aparse__fill_args_dest(
+static void aparse__fill_args_dest(
         const aparse_arg* arg, 
-        uint8_t *buffer);
+        uint8_t *buffer,
+        aparse__level_t *level);
 
 static void aparse__destroy_payload(
         const aparse_arg* args, 
         uint8_t *payload);
+
+static void aparse__dispatch_release(
+        const aparse_allocator* alloc,
+        aparse__dispatch_t* entry);
+
+// Allocation accounting
+static void* aparse__count_alloc(
+        void* userdata,
+        size_t size);
+
+static void* aparse__count_realloc(
+        void* userdata,
+        void* ptr,
+        size_t old_size,
+        size_t new_size);
+
+static void aparse__count_free(
+        void* userdata,
+        void* ptr,
+        size_t size);
+
+#ifdef APARSE_STATS
+static uint64_t aparse__clock_ns(void);
+
+static void aparse__stats_finish(
+        aparse__context_t* ctx);
+#endif
+
+static void aparse__list_fixed(
+        aparse_list* list,
+        void* storage,
+        const size_t capacity);
 // Failure handling
 static aparse_status aparse__check_missing(
-        aparse_context* ctx,
-        aparse_arg* args);
+        aparse_context* ctx);
 
 static void aparse__default_errcb(
         const aparse_context* ctx,
@@ -204,36 +700,137 @@ static void aparse__default_errcb(
         void* userdata);
 
 // Help-related functions
+static size_t aparse__format_text(
+        const aparse_parser* parser,
+        char* buffer,
+        const size_t size,
+        const int width,
+        const bool help);
+
 static void aparse__print_help(
-        aparse_arg* main_args,
         aparse__context_t *ctx);
 
-static void aparse__print_wrapped(
+static void aparse__print_usage(
+        const aparse_context *ctx);
+
+static void aparse__render_init(
+        aparse__render_t* r,
+        char* buffer,
+        const size_t size,
+        const aparse_allocator* alloc,
+        const int width);
+
+static void aparse__render_write(
+        aparse__render_t* r,
+        const char* data,
+        size_t len);
+
+static void aparse__render_str(
+        aparse__render_t* r,
+        const char* str);
+
+static void aparse__render_pad(
+        aparse__render_t* r,
+        int count);
+
+static void aparse__render_flush(
+        aparse__render_t* r);
+
+static void aparse__render_release(
+        aparse__render_t* r);
+
+static void aparse__render_out(
+        const char* data,
+        size_t size);
+
+static void aparse__render_help(
+        aparse__render_t* r,
+        const aparse_context *ctx);
+
+static void aparse__render_wrapped(
+        aparse__render_t* r,
         const char *text, 
-        int start_col, 
-        int term_width);
+        const int start_col);
 
-static void aparse__print_help_tag(
+static void aparse__render_help_tag(
+        aparse__render_t* r,
         const aparse_arg* arg, 
-        const int indent
-);
+        const int indent);
+
+static void aparse__render_metavar(
+        aparse__render_t* r,
+        const aparse_arg* arg);
 
-static void aparse__print_pos_help(
-        aparse_arg* args);
+static void aparse__render_pos_help(
+        aparse__render_t* r,
+        const aparse_arg* args);
 
-static void aparse__print_subcmds(
+static void aparse__render_subcmds(
+        aparse__render_t* r,
         const aparse_arg* args);
 
-static void aparse__print_usage(
+static void aparse__render_usage_before(
+        aparse__render_t* r,
         const aparse_context *ctx);
 
-/* Miscellaneous functions */
-static void aparse__reset_state(
-        aparse_arg *args);
+static void aparse__render_usage_after(
+        aparse__render_t* r,
+        const aparse_arg* args);
+
+static void aparse__render_usage(
+        aparse__render_t* r,
+        const aparse_context *ctx);
+
+/* Schema compilation */
+static aparse__node_t* aparse__compile_node(
+        aparse_schema* schema,
+        const aparse_arg* args,
+        const int depth,
+        const bool is_choices);
 
-static aparse_arg* aparse__argv_match(
+static bool aparse__build_index(
+        aparse__node_t* node,
+        const bool is_choices);
+
+static const aparse_arg* aparse__index_match(
+        const aparse__node_t* node,
+        const char* argv,
+        bool* is_short,
+        bool* has_equal);
+
+/* Miscellaneous functions */
+static const aparse_arg* aparse__argv_match(
         const char* argv, 
-        aparse_arg* args);
+        aparse__context_t* ctx);
+
+static const aparse_arg* aparse__option_match(
+        const aparse__level_t* level,
+        const char* argv,
+        bool* is_short,
+        bool* has_equal);
+
+static bool aparse__is_option(
+        const char* argv,
+        const aparse__context_t* ctx);
+
+static aparse__slot_t* aparse__find_slot(
+        const aparse_context* ctx,
+        const aparse_arg* arg);
+
+static void aparse__mark_match(
+        aparse__slot_t* slot,
+        const bool is_short,
+        const bool has_equal);
+
+static aparse_status aparse__apply_env(
+        aparse__context_t* ctx);
+
+static bool aparse__index_env(
+        aparse__context_t* ctx);
+
+static const char* aparse__env_value(
+        const aparse__context_t* ctx,
+        const char* name);
 
 static const char* aparse__get_exename(
         const char* argv0);
@@ -244,115 +841,510 @@ static int aparse__get_term_width(void);
 aparse_status aparse_parse(
         const int argc, 
         char* const * argv,
-        aparse_arg* args, 
+        const aparse_arg* args, 
         aparse_list* dispatch_list_out, 
         const char* program_desc)
 {
     aparse_status ret = APARSE_STATUS_OK;
-    aparse__context_t ctx = {0};
-    aparse_list unknown_list = {0}; // char*
-    aparse_list dispatch_list = {0}; // aparse__dispatch_entry_t*
+    aparse_parser parser = {
+        .args = args,
+        .desc = program_desc,
+        .err_callback = aparse__err_callback,
+        .err_userdata = aparse__err_userdata
+    };
 
-    if(!argv || argc < 1)
-        return APARSE_STATUS_FAILURE;
-    __aparse_progname = aparse__get_exename(argv[0]);
-    aparse__desc = program_desc;
+    // Legacy callbacks may still rely on the global program name
+    if(argv && argc > 0)
+        __aparse_progname = aparse__get_exename(argv[0]);
+    ret = aparse__parse_root(&parser, argc, argv, dispatch_list_out);
+    return ret;
+}
 
-    if(!args)
-        return APARSE_STATUS_OK;
+aparse_status aparse_parse_schema(
+        const int argc, 
+        char* const * argv,
+        const aparse_schema* schema, 
+        aparse_list* dispatch_list_out, 
+        const char* program_desc)
+{
+    aparse_status ret = APARSE_STATUS_OK;
+    aparse_parser parser = {
+        .schema = schema,
+        .desc = program_desc,
+        .err_callback = aparse__err_callback,
+        .err_userdata = aparse__err_userdata
+    };
 
-    unknown_list.itemsz = sizeof(const char*);
-    dispatch_list.itemsz = sizeof(aparse__dispatch_t);
+    // Legacy callbacks may still rely on the global program name
+    if(argv && argc > 0)
+        __aparse_progname = aparse__get_exename(argv[0]);
+    ret = aparse__parse_root(&parser, argc, argv, dispatch_list_out);
+    return ret;
+}
 
-    ctx.idx = 1;
-    ctx.unknown = &unknown_list;
-    ctx.dispatch = &dispatch_list;
-    
-    if(!aparse__err_callback)
-        aparse_set_error_callback(NULL, NULL);
+aparse_parser* aparse_parser_new(
+        const aparse_schema* schema,
+        const char* program_desc)
+{
+    aparse_parser *parser = 0;
+    if(!schema)
+        return NULL;
+
+    parser = aparse_allocator_alloc(NULL, sizeof(*parser));
+    if(!parser)
+        return NULL;
+    memset(parser, 0, sizeof(*parser));
+    parser->schema = schema;
+    parser->desc = program_desc;
+    parser->err_callback = aparse__err_callback;
+    parser->err_userdata = aparse__err_userdata;
+    parser->keep_storage = true;
+    return parser;
+}
 
-    aparse__reset_state(args);
-    ret = aparse__parse_impl(argc, argv, args, &ctx);
-    if(ret == APARSE_STATUS_OK)
-        ret = aparse__check_missing(&ctx, args);
-    
-    if(ret == APARSE_STATUS_OK && unknown_list.size > 0)
+void aparse_parser_free(
+        aparse_parser* parser)
+{
+    if(parser)
     {
-        aparse__raise_nonfatal(&ctx, APARSE_STATUS_UNKNOWN_ARGUMENT, \
-                &unknown_list, NULL);
-        ret = APARSE_STATUS_FAILURE;
+        aparse__release_responses(parser);
+        aparse__release_storage(parser);
     }
-    aparse_list_free(&unknown_list);
+    aparse_allocator_free(NULL, parser, sizeof(*parser));
+}
 
-    if(ret == APARSE_STATUS_OK)
-    {
-        if(dispatch_list_out)
-            *dispatch_list_out = dispatch_list;
-        else
-            aparse_dispatch_all(&dispatch_list);
-    }
+void aparse_parser_set_error_callback(
+        aparse_parser* parser,
+        const aparse_error_callback cb, 
+        void* userdata)
+{
+    if(!parser)
+        return;
+    parser->err_callback = cb;
+    parser->err_userdata = cb ? userdata : NULL;
+}
 
-    return ret;
+void aparse_parser_set_allocator(
+        aparse_parser* parser,
+        const aparse_allocator* allocator)
+{
+    if(!parser)
+        return;
+    aparse__release_storage(parser);
+    parser->allocator = allocator;
+    parser->no_alloc = false;
+    parser->keep_storage = true;
 }
 
-void aparse_dispatch_all(
-        aparse_list* dispatch_list)
+void aparse_parser_set_no_alloc(
+        aparse_parser* parser,
+        void* region,
+        const size_t size)
 {
-    if(!dispatch_list || !dispatch_list->ptr || dispatch_list->size < 1)
+    if(!parser)
         return;
-    if(dispatch_list->itemsz != sizeof(aparse__dispatch_t))
+    aparse__release_storage(parser);
+    parser->keep_storage = false;
+    aparse_arena_init(&parser->region, region, region ? size : 0);
+    // Without a region the arena must not fall back to owning blocks
+    parser->region.block_size = 0;
+    parser->allocator = aparse_arena_allocator(&parser->region);
+    parser->no_alloc = true;
+}
+
+void aparse_parser_set_threads(
+        aparse_parser* parser,
+        const unsigned threads,
+        const size_t threshold)
+{
+    if(!parser)
         return;
+    parser->threads = threads > APARSE__MAX_THREADS ? APARSE__MAX_THREADS : threads;
+    parser->thread_threshold = threshold ? threshold : APARSE__THREAD_THRESHOLD;
+}
 
-    for(size_t i = 0; i < dispatch_list->size; i++)
-    {
-        aparse__dispatch_t *entry = 
-            &aparse_list_get(dispatch_list, aparse__dispatch_t, i);
+void aparse_parser_set_arena(
+        aparse_parser* parser,
+        aparse_arena* arena)
+{
+    aparse_parser_set_allocator(parser, aparse_arena_allocator(arena));
+    // Resetting the arena would free the slot cache under the parser
+    if(parser && arena)
+        parser->keep_storage = false;
+}
 
-        entry->args->handler(entry->args, entry->payload);
-        aparse__destroy_payload(entry->args, entry->payload);
-    }
-    aparse_list_free(dispatch_list);
+aparse_alloc_stats aparse_parser_alloc_stats(
+        const aparse_parser* parser)
+{
+    if(!parser)
+        return (aparse_alloc_stats){0};
+    return parser->stats;
 }
 
-int aparse_dispatch_contain(
-        const aparse_list* dispatch_list, 
-        const char* name)
+aparse_stats aparse_parser_stats(
+        const aparse_parser* parser)
 {
-    if(
-            !dispatch_list || 
-            !dispatch_list->ptr || 
-            dispatch_list->size < 1 || 
-            !name || 
-            !*name
-    ) return 0;
-    aparse__dispatch_t* list = dispatch_list->ptr;
-    for(size_t i = 0; i < dispatch_list->size; i++)
-    {
-        if(!list[i].args->longopt)
-            continue;
-        if(!strcmp(list[i].args->longopt, name))
-            return 1;
-    }
-    return 0;
+#ifdef APARSE_STATS
+    if(parser)
+        return parser->phase_stats;
+#else
+    (void)parser;
+#endif
+    return (aparse_stats){0};
 }
 
-void aparse_dispatch_free(
-        aparse_list* dispatch_list)
+void aparse_parser_set_response_files(
+        aparse_parser* parser,
+        const bool enable)
 {
-    if(!dispatch_list || !dispatch_list->ptr || dispatch_list->size < 1)
+    if(!parser)
         return;
-    aparse__dispatch_t* list = dispatch_list->ptr;
-    for(size_t i = 0; i < dispatch_list->size; i++)
-        if(list[i].payload)
-            free(list[i].payload);
+    parser->response_files = enable;
 }
 
-void aparse_set_error_callback(const aparse_error_callback cb, void* userdata)
+const char* aparse_parser_progname(
+        const aparse_parser* parser)
 {
-    if(!cb)
-    {
-        aparse__err_callback = aparse__default_errcb;
-        aparse__err_userdata = NULL;
+    return parser ? parser->progname : NULL;
+}
+
+void aparse_parser_set_lazy(
+        aparse_parser* parser,
+        const bool enable)
+{
+    if(!parser)
+        return;
+    parser->lazy = enable;
+}
+
+aparse_status aparse_get_i64(
+        aparse_parser* parser,
+        const aparse_arg* arg,
+        int64_t* value)
+{
+    return aparse__get_number(parser, arg, APARSE_ARG_TYPE_SIGNED, value);
+}
+
+aparse_status aparse_get_u64(
+        aparse_parser* parser,
+        const aparse_arg* arg,
+        uint64_t* value)
+{
+    return aparse__get_number(parser, arg, APARSE_ARG_TYPE_UNSIGNED, value);
+}
+
+aparse_status aparse_get_f64(
+        aparse_parser* parser,
+        const aparse_arg* arg,
+        double* value)
+{
+    return aparse__get_number(parser, arg, APARSE_ARG_TYPE_FLOAT, value);
+}
+
+size_t aparse_parser_format_help(
+        const aparse_parser* parser,
+        char* buffer,
+        const size_t size,
+        const int width)
+{
+    return aparse__format_text(parser, buffer, size, width, true);
+}
+
+size_t aparse_parser_format_usage(
+        const aparse_parser* parser,
+        char* buffer,
+        const size_t size)
+{
+    return aparse__format_text(parser, buffer, size, 0, false);
+}
+
+aparse_status aparse_parse_ex(
+        aparse_parser* parser,
+        const int argc, 
+        char* const * argv,
+        aparse_list* dispatch_list_out)
+{
+    if(!parser)
+        return APARSE_STATUS_FAILURE;
+    return aparse__parse_root(parser, argc, argv, dispatch_list_out);
+}
+
+aparse_schema* aparse_compile(
+        const aparse_arg* args)
+{
+    aparse_schema* schema = 0;
+    if(!args)
+        return NULL;
+
+    schema = aparse_allocator_alloc(NULL, sizeof(*schema));
+    if(!schema)
+        return NULL;
+    memset(schema, 0, sizeof(*schema));
+    schema->nodes.itemsz = sizeof(aparse__node_t*);
+
+    schema->root = aparse__compile_node(schema, args, 0, false);
+    if(!schema->root)
+    {
+        aparse_schema_free(schema);
+        return NULL;
+    }
+    return schema;
+}
+
+void aparse_schema_free(
+        aparse_schema* schema)
+{
+    if(!schema)
+        return;
+    for(size_t i = 0; i < schema->nodes.size; i++)
+    {
+        aparse__node_t *node = 
+            aparse_list_get(&schema->nodes, aparse__node_t*, i);
+        aparse_allocator_free(NULL, (void*)(uintptr_t)node->index, 
+                node->index_size * sizeof(uint32_t));
+        aparse_allocator_free(NULL, node, aparse__node_block_size(node->count));
+    }
+    aparse_list_free(&schema->nodes);
+    aparse_allocator_free(NULL, schema, sizeof(*schema));
+}
+
+void aparse_dispatch_all(
+        aparse_list* dispatch_list)
+{
+    if(!dispatch_list || !dispatch_list->ptr || dispatch_list->size < 1)
+        return;
+    if(dispatch_list->itemsz != sizeof(aparse__dispatch_t))
+        return;
+
+    for(size_t i = 0; i < dispatch_list->size; i++)
+    {
+        aparse__dispatch_t *entry = 
+            &aparse_list_get(dispatch_list, aparse__dispatch_t, i);
+
+        if(entry->args->handler)
+            entry->args->handler(entry->args, entry->payload);
+        aparse__dispatch_release(dispatch_list->allocator, entry);
+    }
+    aparse_list_free(dispatch_list);
+}
+
+int aparse_dispatch_contain(
+        const aparse_list* dispatch_list, 
+        const char* name)
+{
+    if(
+            !dispatch_list || 
+            !dispatch_list->ptr || 
+            dispatch_list->size < 1 || 
+            !name || 
+            !*name
+    ) return 0;
+    aparse__dispatch_t* list = dispatch_list->ptr;
+    for(size_t i = 0; i < dispatch_list->size; i++)
+    {
+        if(!list[i].args->longopt)
+            continue;
+        if(!strcmp(list[i].args->longopt, name))
+            return 1;
+    }
+    return 0;
+}
+
+void aparse_dispatch_free(
+        aparse_list* dispatch_list)
+{
+    if(!dispatch_list || !dispatch_list->ptr || dispatch_list->size < 1)
+        return;
+    if(dispatch_list->itemsz != sizeof(aparse__dispatch_t))
+        return;
+    aparse__dispatch_t* list = dispatch_list->ptr;
+    for(size_t i = 0; i < dispatch_list->size; i++)
+        aparse__dispatch_release(dispatch_list->allocator, &list[i]);
+    aparse_list_free(dispatch_list);
+}
+
+aparse_status aparse_dispatch_parallel(
+        aparse_list* dispatch_list,
+        const unsigned threads,
+        const aparse_dispatch_dep* deps,
+        const size_t dep_count,
+        aparse_dispatch_result* results)
+{
+    aparse__worker_t workers[APARSE__MAX_THREADS];
+    aparse__pool_t pool = {0};
+    aparse_status status = APARSE_STATUS_OK;
+    size_t *storage = NULL, *pairs = NULL, *scratch = NULL;
+    size_t count = 0, edges = 0, storage_size = 0;
+
+    if(!dispatch_list || !dispatch_list->ptr || dispatch_list->size < 1)
+        return APARSE_STATUS_OK;
+    if(dispatch_list->itemsz != sizeof(aparse__dispatch_t))
+        return APARSE_STATUS_INVALID_SIZE;
+
+    count = dispatch_list->size;
+    pool.entries = dispatch_list->ptr;
+    pool.count = count;
+    pool.workers = workers;
+    pool.worker_count = (unsigned)APARSE__MIN(
+            APARSE__MIN((size_t)threads, (size_t)APARSE__MAX_THREADS), count);
+    if(pool.worker_count < 1)
+        pool.worker_count = 1;
+
+    // pending, first, dependents, the edge pairs, one deque per worker,
+    // and a queue for the cycle check
+    edges = deps ? aparse__pool_edges(&pool, deps, dep_count, NULL) : 0;
+    storage_size = (count + (count + 1) + edges + 2 * edges + 
+            pool.worker_count * count + count) * sizeof(size_t);
+    storage = aparse_allocator_alloc(dispatch_list->allocator, storage_size);
+    if(storage)
+    {
+        pool.pending = storage;
+        pool.first = pool.pending + count;
+        pool.dependents = pool.first + count + 1;
+        pairs = pool.dependents + edges;
+        scratch = pairs + 2 * edges;
+        for(unsigned i = 0; i < pool.worker_count; i++)
+        {
+            workers[i] = (aparse__worker_t){
+                .pool = &pool,
+                .id = i,
+                .items = scratch + count + i * count
+            };
+        }
+        if(edges)
+            aparse__pool_edges(&pool, deps, dep_count, pairs);
+        if(!aparse__pool_build(&pool, pairs, edges, scratch))
+            status = APARSE_STATUS_FAILURE;
+    } else
+        status = APARSE_STATUS_ALLOC_FAILURE;
+
+    if(results)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            results[i] = (aparse_dispatch_result){
+                .args = pool.entries[i].args,
+                .status = status == APARSE_STATUS_OK ? 
+                    APARSE_STATUS_FAILURE : status
+            };
+        }
+        pool.results = results;
+    }
+
+    if(status == APARSE_STATUS_OK)
+    {
+#ifndef APARSE_NO_THREADS
+        bool started[APARSE__MAX_THREADS] = {0};
+#endif
+        // Entries without dependencies are dealt out to every worker, the
+        // deques of threads that failed to start are emptied by stealing
+        for(size_t i = 0, next = 0; i < count; i++)
+        {
+            if(pool.pending[i] == 0)
+            {
+                aparse__worker_t *worker = &workers[next++ % pool.worker_count];
+                worker->items[worker->bottom++] = i;
+            }
+        }
+        pool.remaining = count;
+        aparse__mutex_init(&pool.lock);
+        aparse__cond_init(&pool.wake);
+        for(unsigned i = 0; i < pool.worker_count; i++)
+            aparse__mutex_init(&workers[i].lock);
+#ifndef APARSE_NO_THREADS
+        for(unsigned i = 1; i < pool.worker_count; i++)
+            started[i] = aparse__thread_start(&workers[i].thread, 
+                    aparse__pool_run, &workers[i]);
+#endif
+        aparse__pool_run(&workers[0]);
+#ifndef APARSE_NO_THREADS
+        for(unsigned i = 1; i < pool.worker_count; i++)
+        {
+            if(started[i])
+                aparse__thread_join(&workers[i].thread);
+        }
+#endif
+        for(unsigned i = 0; i < pool.worker_count; i++)
+            aparse__mutex_destroy(&workers[i].lock);
+        aparse__cond_destroy(&pool.wake);
+        aparse__mutex_destroy(&pool.lock);
+    }
+
+    aparse_allocator_free(dispatch_list->allocator, storage, storage_size);
+    for(size_t i = 0; i < count; i++)
+        aparse__dispatch_release(dispatch_list->allocator, &pool.entries[i]);
+    aparse_list_free(dispatch_list);
+    return status;
+}
+
+aparse_status aparse_parse_batch(
+        const aparse_schema* schema,
+        const size_t count,
+        const int* argcs,
+        char* const* const* argvs,
+        const unsigned threads,
+        aparse_batch_result* results)
+{
+    aparse__batch_task_t tasks[APARSE__MAX_THREADS];
+    size_t workers = 0, chunk = 0, begin = 0, failed = 0;
+#ifndef APARSE_NO_THREADS
+    aparse__thread_t handles[APARSE__MAX_THREADS];
+    bool started[APARSE__MAX_THREADS] = {0};
+#endif
+
+    if(count == 0)
+        return APARSE_STATUS_OK;
+    if(!schema || !argcs || !argvs || !results)
+        return APARSE_STATUS_NULL_POINTER;
+
+    workers = APARSE__MIN(APARSE__MIN((size_t)threads, 
+                (size_t)APARSE__MAX_THREADS), count);
+#ifdef APARSE_NO_THREADS
+    workers = 1;
+#endif
+    if(workers < 1)
+        workers = 1;
+    chunk = (count + workers - 1) / workers;
+    for(size_t i = 0; i < workers; i++, begin += chunk)
+    {
+        tasks[i] = (aparse__batch_task_t){
+            .schema = schema,
+            .argcs = argcs + begin,
+            .argvs = argvs + begin,
+            .results = results + begin,
+            .count = APARSE__MIN(chunk, count - begin)
+        };
+    }
+
+#ifndef APARSE_NO_THREADS
+    for(size_t i = 1; i < workers; i++)
+        started[i] = aparse__thread_start(&handles[i], 
+                aparse__batch_task_run, &tasks[i]);
+#endif
+    aparse__batch_task_run(&tasks[0]);
+    for(size_t i = 1; i < workers; i++)
+    {
+#ifndef APARSE_NO_THREADS
+        if(started[i])
+        {
+            aparse__thread_join(&handles[i]);
+            continue;
+        }
+#endif
+        aparse__batch_task_run(&tasks[i]);
+    }
+
+    for(size_t i = 0; i < workers; i++)
+        failed += tasks[i].failed;
+    return failed ? APARSE_STATUS_FAILURE : APARSE_STATUS_OK;
+}
+
+void aparse_set_error_callback(const aparse_error_callback cb, void* userdata)
+{
+    if(!cb)
+    {
+        aparse__err_callback = aparse__default_errcb;
+        aparse__err_userdata = NULL;
         return;
     }
     
@@ -378,7 +1370,9 @@ const char* aparse_error_msg(const aparse_status status)
         [APARSE_STATUS_INVALID_SIZE]        = "Argument size is invalid for its type.",
         [APARSE_STATUS_INVALID_LAYOUT]      = "The given data layout for subcommand is invalid",
         [APARSE_STATUS_ALLOC_FAILURE]       = "Memory allocation failed.",
-        [APARSE_STATUS_UNHANDLED]           = "Unhandled type of argument."
+        [APARSE_STATUS_UNHANDLED]           = "Unhandled type of argument.",
+        [APARSE_STATUS_TOO_DEEP]            = "Parser nesting depth exceeded the limit.",
+        [APARSE_STATUS_RESPONSE_FILE]       = "Response file could not be read."
     };
     if(status < 0 && status >= __APARSE_STATUS_ENUM_END__)
         return "Unknown error";
@@ -386,64 +1380,193 @@ const char* aparse_error_msg(const aparse_status status)
 }
 
 // --------------------------------------- PRIVATE ---------------------------------------
-static aparse_status aparse__parse_impl(
+static aparse_status aparse__parse_root(
+        aparse_parser* parser,
         const int argc, 
-        char* const * argv, 
-        aparse_arg* args, 
-        aparse__context_t* ctx)
+        char* const * argv,
+        aparse_list* dispatch_list_out)
 {
-    int *idx = &ctx->idx;
+    aparse_status ret = APARSE_STATUS_OK;
+    aparse__context_t ctx = {0};
+    aparse_list unknown_list = {0}; // char*
+    aparse_list dispatch_list = {0}; // aparse__dispatch_entry_t*
+    const aparse__node_t *root = parser->schema ? parser->schema->root : NULL;
+    const aparse_arg *args = root ? root->args : parser->args;
+
+    if(!argv || argc < 1)
+        return APARSE_STATUS_FAILURE;
+    parser->progname = aparse__get_exename(argv[0]);
+
     if(!args)
         return APARSE_STATUS_OK;
 
-    if(ctx->stack_top >= APARSE__MAX_DEPTH)
-        return APARSE_STATUS_TOO_DEEP;
+    ctx.parser = parser;
+    aparse__probe_start(&ctx);
+    // Nothing of the last parse may point into them anymore
+    aparse__release_responses(parser);
+    parser->deferred_count = 0;
+    if(!parser->keep_storage)
+    {
+        // Left in the arena of the last parse
+        parser->deferred = NULL;
+        parser->deferred_capacity = 0;
+    }
+    if(parser->no_alloc)
+        aparse_arena_reset(&parser->region);
+    ctx.backing = parser->allocator;
+    ctx.counter = (aparse_allocator){
+        .alloc = aparse__count_alloc,
+        .realloc = aparse__count_realloc,
+        .free = aparse__count_free,
+        .userdata = &ctx
+    };
+    ctx.alloc = &ctx.counter;
+    aparse__reserve_slots(&ctx);
+
+    unknown_list.itemsz = sizeof(const char*);
+    unknown_list.allocator = ctx.alloc;
+    dispatch_list.itemsz = sizeof(aparse__dispatch_t);
+    dispatch_list.allocator = ctx.alloc;
+    if(parser->no_alloc)
+    {
+        aparse__list_fixed(&unknown_list, 
+                ctx.inline_unknown, APARSE__INLINE_LIST);
+        aparse__list_fixed(&dispatch_list, 
+                ctx.inline_dispatch, APARSE__INLINE_LIST);
+    }
+
+    ctx.argv = argv;
+    ctx.argc = argc;
+    ctx.idx = 1;
+    ctx.unknown = &unknown_list;
+    ctx.dispatch = &dispatch_list;
+    
+    if(!parser->err_callback)
+        parser->err_callback = aparse__default_errcb;
+
+    ret = aparse__push_level(&ctx, args, root);
+    if(ret == APARSE_STATUS_OK)
+    {
+        ret = aparse__parse_impl(&ctx);
+        if(ret == APARSE_STATUS_OK)
+            ret = aparse__apply_env(&ctx);
+        if(ret == APARSE_STATUS_OK)
+        {
+            aparse__probe_begin(start);
+            ret = aparse__check_missing(&ctx);
+            aparse__probe_end(&ctx, APARSE__PHASE_MISSING, start);
+        }
+        aparse__pop_level(&ctx);
+    }
     
-    ctx->stack[ctx->stack_top++] = args;
-    while (*idx < argc) {
-        const char* cargv = argv[*idx];
+    if(ret == APARSE_STATUS_OK && unknown_list.size > 0)
+    {
+        aparse__raise_nonfatal(&ctx, APARSE_STATUS_UNKNOWN_ARGUMENT, \
+                &unknown_list, NULL);
+        ret = APARSE_STATUS_FAILURE;
+    }
+    aparse_list_free(&unknown_list);
+    aparse_allocator_free(ctx.alloc, ctx.tokens, 
+            ctx.tokens_size * sizeof(char*));
+    aparse_allocator_free(ctx.alloc, ctx.env_index, 
+            ctx.env_size * sizeof(char*));
+    parser->stats = ctx.stats;
+
+    // ctx.counter dies with this frame
+    if(dispatch_list.allocator == ctx.alloc)
+        dispatch_list.allocator = ctx.backing;
+    if(ret == APARSE_STATUS_OK && parser->no_alloc && 
+            dispatch_list_out && dispatch_list.size > 0)
+    {
+        // The inline entries die with this frame too, move them to the region
+        size_t bytes = dispatch_list.size * dispatch_list.itemsz;
+        void *entries = aparse_allocator_alloc(ctx.backing, bytes);
+        if(entries)
+        {
+            memcpy(entries, dispatch_list.ptr, bytes);
+            dispatch_list.ptr = entries;
+            dispatch_list.capacity = dispatch_list.size;
+            dispatch_list.allocator = ctx.backing;
+        } else {
+            aparse__raise_nonfatal(&ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+            ret = APARSE_STATUS_FAILURE;
+        }
+    }
+    if(ret == APARSE_STATUS_OK)
+    {
+        if(dispatch_list_out)
+            *dispatch_list_out = dispatch_list;
+        else
+        {
+            aparse__probe_begin(start);
+            aparse_dispatch_all(&dispatch_list);
+            aparse__probe_end(&ctx, APARSE__PHASE_DISPATCH, start);
+        }
+    } else
+        aparse_dispatch_free(&dispatch_list);
+
+    aparse__probe_finish(&ctx);
+    return ret;
+}
+
+static aparse_status aparse__parse_impl(
+        aparse__context_t* ctx)
+{
+    int *idx = &ctx->idx;
+    aparse__level_t *level = &ctx->stack[ctx->stack_top - 1];
+
+    while (*idx < ctx->argc) {
+        if(aparse__expand_response(ctx, *idx) != APARSE_STATUS_OK)
+            return APARSE_STATUS_FAILURE;
+        if(*idx >= ctx->argc)
+            break;
+        const char* cargv = ctx->argv[*idx];
         (*idx)++;
 
-        aparse_arg* ptr = aparse__argv_match(cargv, args);
+        aparse__probe_begin(start);
+        const aparse_arg* ptr = aparse__argv_match(cargv, ctx);
+        aparse__probe_end(ctx, APARSE__PHASE_MATCH, start);
+        aparse__probe_match(ctx, ptr);
         if(ptr) {
             if(aparse__is_positional(ptr)) 
             {
-                ptr->flags |= APARSE__ARG_PROCESSED;
+                aparse__level_slot(level, (size_t)(ptr - level->args))->flags |= 
+                    APARSE__ARG_PROCESSED;
                 if(aparse__is_argument(ptr)) 
                 {
                     aparse_status status = APARSE_STATUS_OK;
                     if(ptr->type & APARSE_ARG_TYPE_ARRAY)
                     {
-                        status = aparse__process_array(
-                                argc, 
-                                argv, 
-                                ptr, 
-                                ctx);
+                        status = aparse__process_array(ptr, ctx);
                     } else {
+                        const aparse__slot_t *slot = 
+                            aparse__level_slot(level, (size_t)(ptr - level->args));
                         status = aparse__process_argument(
                                 cargv, 
                                 ptr, 
+                                slot->ptr,
+                                slot->size,
                                 ctx);
                     }
 
                     if(status != APARSE_STATUS_OK)
                         return APARSE_STATUS_FAILURE;
                 } else  {
-                    if(aparse__process_parser(argc, cargv, argv, ptr, 
+                    if(aparse__process_parser(cargv, ptr, 
+                                level->node ? 
+                                    level->node->children[ptr - level->args] : 
+                                    NULL,
                                 ctx) != APARSE_STATUS_OK)
                         return APARSE_STATUS_FAILURE;
-                    ctx->stack_top--;
                 }
             } else {
                 if(ptr->shortopt != aparse__help_arg.shortopt) {
-                    if(aparse_process_optional(
-                                argc, 
-                                argv, 
-                                ptr, 
-                                ctx) != APARSE_STATUS_OK)
+                    if(aparse_process_optional(ptr, ctx) != APARSE_STATUS_OK)
                         return APARSE_STATUS_FAILURE;
                 } else {
-                    aparse__print_help(args, ctx);
+                    if(ctx->parser->batch)
+                        aparse__raise_fatal(ctx, APARSE_STATUS_FAILURE, ptr, 0);
+                    aparse__print_help(ctx);
                     return APARSE_STATUS_FAILURE;
                 }
             }
@@ -465,377 +1588,1227 @@ static aparse_status aparse__parse_impl(
     return APARSE_STATUS_OK;
 }
 
-static aparse_status aparse__process_argument(
-        const char* argv, 
-        const aparse_arg *arg,
-        aparse__context_t *ctx) 
+static aparse_status aparse__push_level(
+        aparse__context_t* ctx,
+        const aparse_arg* args,
+        const aparse__node_t* node)
 {
-    if (!arg->ptr)
+    aparse_parser *parser = ctx->parser;
+    aparse__level_t *level = NULL;
+    size_t count = 0;
+
+    if(ctx->stack_top >= APARSE__MAX_DEPTH)
+        return APARSE_STATUS_TOO_DEEP;
+
+    if(node)
+        count = node->count;
+    else
     {
-        aparse__raise_nonfatal(ctx, APARSE_STATUS_NULL_POINTER, arg, NULL);
-        return APARSE_STATUS_OK; // continue
+        aparse__tillend(arg, args)
+            count++;
+    }
+
+    level = &ctx->stack[ctx->stack_top];
+    level->args = args;
+    level->node = node;
+    level->count = count;
+    // Every slot the level takes is stale from here on, nothing to clear
+    level->stamp = ++parser->stamp;
+    if(ctx->inline_used + count <= APARSE__INLINE_SLOTS)
+    {
+        level->slots = &parser->inline_slots[ctx->inline_used];
+        ctx->inline_used += count;
+    } else if(ctx->cache_used + count <= parser->slot_cache_size) {
+        level->slots = &parser->slot_cache[ctx->cache_used];
+        ctx->cache_used += count;
+    } else {
+        if(parser->keep_storage && 
+                ctx->cache_used + count > parser->slot_cache_wanted)
+            parser->slot_cache_wanted = ctx->cache_used + count;
+        level->slots = aparse_allocator_alloc(ctx->alloc,
+                count * sizeof(aparse__slot_t));
+        if(!level->slots)
+            aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+        memset(level->slots, 0, count * sizeof(aparse__slot_t));
+    }
+    for(size_t i = 0; parser->batch && i < count; i++)
+    {
+        if(args[i].ptr && aparse__is_argument(&args[i]) &&
+                !(args[i].type & APARSE_ARG_TYPE_STREAM))
+        {
+            // Shared by every input, values are only checked into scratch
+            const size_t size = aparse__eval_size(&args[i]);
+            void *scratch = NULL;
+            if(size == 0)
+                continue;
+            scratch = aparse_allocator_alloc(ctx->alloc, size);
+            if(!scratch)
+                aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+            memset(scratch, 0, size);
+            aparse__level_slot(level, i)->ptr = scratch;
+        }
     }
-    if (arg->size <= 0 && !(arg->type & APARSE_ARG_TYPE_STRING))
-        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SIZE, arg, &arg->size);
+    ctx->stack_top++;
+    return APARSE_STATUS_OK;
+}
+
+static void aparse__pop_level(
+        aparse__context_t* ctx)
+{
+    aparse__level_t *level = &ctx->stack[--ctx->stack_top];
+    const aparse_parser *parser = ctx->parser;
+    if(level->slots >= parser->inline_slots && 
+            level->slots < parser->inline_slots + APARSE__INLINE_SLOTS)
+        ctx->inline_used -= level->count;
+    else if(level->slots >= parser->slot_cache && 
+            level->slots < parser->slot_cache + parser->slot_cache_size)
+        ctx->cache_used -= level->count;
+    else
+        aparse_allocator_free(ctx->alloc, level->slots, 
+                level->count * sizeof(aparse__slot_t));
+    level->slots = NULL;
+}
+
+// Grows the slot cache to what the last parse could not find in it,
+// counted as an allocation of this parse
+static void aparse__reserve_slots(
+        aparse__context_t* ctx)
+{
+    aparse_parser *parser = ctx->parser;
+    aparse__slot_t *cache = NULL;
+    if(!parser->keep_storage || 
+            parser->slot_cache_wanted <= parser->slot_cache_size)
+        return;
+    cache = aparse_allocator_alloc(ctx->alloc, 
+            parser->slot_cache_wanted * sizeof(aparse__slot_t));
+    if(!cache)
+        return;
+    memset(cache, 0, parser->slot_cache_wanted * sizeof(aparse__slot_t));
+    aparse_allocator_free(ctx->alloc, parser->slot_cache, 
+            parser->slot_cache_size * sizeof(aparse__slot_t));
+    parser->slot_cache = cache;
+    parser->slot_cache_size = parser->slot_cache_wanted;
+}
+
+// What the parser kept from its allocator, before the allocator changes
+static void aparse__release_storage(
+        aparse_parser* parser)
+{
+    if(!parser->keep_storage)
+        return;
+    aparse_allocator_free(parser->allocator, parser->slot_cache, 
+            parser->slot_cache_size * sizeof(aparse__slot_t));
+    parser->slot_cache = NULL;
+    parser->slot_cache_size = 0;
+    parser->slot_cache_wanted = 0;
+    aparse_allocator_free(parser->allocator, parser->deferred, 
+            parser->deferred_capacity * sizeof(aparse__deferred_t));
+    parser->deferred = NULL;
+    parser->deferred_count = 0;
+    parser->deferred_capacity = 0;
+}
 
+// Convert argv into dest without reporting anything, safe on any thread
+static aparse_status aparse__convert_element(
+        const aparse_arg* arg,
+        const char* argv,
+        void* dest,
+        const size_t size)
+{
     switch(arg->type & APARSE_ARG_TYPE_BITMASK)
     {
         case APARSE_ARG_TYPE_STRING:
         {
-            size_t len = strlen(argv) + 1;
-
-            if (arg->size == 0) 
+            if (size == 0) 
             {
-                const char** dst = (const char**)arg->ptr;
+                const char** dst = (const char**)dest;
                 *dst = argv;
             } else {
-                size_t n = APARSE__MIN(arg->size - 1, len);
-                memcpy(arg->ptr, argv, n);
-                ((char*)arg->ptr)[n] = '\0';
+                // Only scan as far as the destination can hold
+                const char *end = memchr(argv, '\0', size - 1);
+                const size_t n = end ? (size_t)(end - argv) : size - 1;
+                memcpy(dest, argv, n);
+                ((char*)dest)[n] = '\0';
             }
-            break;
+            return APARSE_STATUS_OK;
         }
+        case APARSE_ARG_TYPE_STRING_VIEW:
+            *(aparse_string_view*)dest = (aparse_string_view){
+                .ptr = argv,
+                .len = strlen(argv)
+            };
+            return APARSE_STATUS_OK;
         case APARSE_ARG_TYPE_UNSIGNED:
-        {
-            bool have_sign = arg->type & APARSE_ARG_TYPE_SIGNED_FLAGS;
-            if(arg->size > sizeof(uint64_t))
-                aparse__raise_fatal(ctx, APARSE_STATUS_UNHANDLED, arg, 0);
+            return aparse_convert_integer(argv, dest, size,
+                    arg->type & APARSE_ARG_TYPE_SIGNED_FLAGS);
+        case APARSE_ARG_TYPE_FLOAT:
+            return aparse_convert_float(argv, dest, size);
+        default:
+            return APARSE_STATUS_INVALID_TYPE;
+    }
+}
 
-            // Determine base
-            int base = 10;
-            const char* p = argv;
-            bool is_negative = false;
+// Array elements up to the first failure, safe on any thread
+static aparse_status aparse__convert_elements(
+        const aparse_arg* arg,
+        char* const* argv,
+        uint8_t* dest,
+        const size_t count,
+        const size_t increment,
+        size_t* converted)
+{
+    if(!aparse__type_cmp(arg, APARSE_ARG_TYPE_STRING) &&
+            !aparse__type_cmp(arg, APARSE_ARG_TYPE_STRING_VIEW))
+        return aparse_convert_batch(argv, count, dest, arg->element_size,
+                arg->type & (APARSE_ARG_TYPE_BITMASK | APARSE_ARG_TYPE_SIGNED_FLAGS),
+                converted);
 
-            if (*p == '-' || *p == '+') {
-                if (*p == '-') is_negative = true;
-                p++;
-            }
-            if(is_negative && !have_sign)
-                aparse__raise_fatal(ctx, APARSE_STATUS_UNDERFLOW, arg, 0);
+    for(*converted = 0; *converted < count; (*converted)++, dest += increment)
+    {
+        aparse_status status = aparse__convert_element(
+                arg, argv[*converted], dest, arg->element_size);
+        if(status != APARSE_STATUS_OK)
+            return status;
+    }
+    return APARSE_STATUS_OK;
+}
 
-            if (p[0] == '0') {
-                switch(tolower(p[1]))
-                {
-                    case 'x': base = 16; p += 2; break;
-                    case 'b': base = 2 ; p += 2; break;
-                    case 'o': base = 8 ; p += 2; break;
-                    default:  base = 8;  p++; break;
-                }
+// Only a float underflow lets the parse go on
+static aparse_status aparse__raise_conversion(
+        aparse__context_t* ctx,
+        const aparse_arg* arg,
+        const char* argv,
+        const aparse_status status)
+{
+    if(status == APARSE_STATUS_UNDERFLOW && 
+            aparse__type_cmp(arg, APARSE_ARG_TYPE_FLOAT))
+    {
+        aparse__raise_nonfatal(ctx, status, arg, argv);
+        return APARSE_STATUS_OK;
+    }
+    if(status == APARSE_STATUS_UNHANDLED || status == APARSE_STATUS_INVALID_TYPE)
+        aparse__raise_fatal(ctx, status, arg, 0);
+    aparse__raise_fatal(ctx, status, arg, argv);
+}
+
+static aparse_status aparse__process_argument(
+        const char* argv, 
+        const aparse_arg *arg,
+        void* dest,
+        const size_t size,
+        aparse__context_t *ctx) 
+{
+    aparse_status status = APARSE_STATUS_OK;
+    if (!dest)
+    {
+        aparse__raise_nonfatal(ctx, APARSE_STATUS_NULL_POINTER, arg, NULL);
+        return APARSE_STATUS_OK; // continue
+    }
+    if (size <= 0 && !aparse__type_cmp(arg, APARSE_ARG_TYPE_STRING))
+        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SIZE, arg, &size);
+    if (size < sizeof(aparse_string_view) && 
+            aparse__type_cmp(arg, APARSE_ARG_TYPE_STRING_VIEW))
+        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SIZE, arg, &size);
+    // Payload members must be ready for the handler, only numbers of
+    // the program's own variables can wait for aparse_get_*
+    if(ctx->parser->lazy && !ctx->parser->no_alloc && dest == arg->ptr &&
+            (aparse__type_cmp(arg, APARSE_ARG_TYPE_UNSIGNED) ||
+             aparse__type_cmp(arg, APARSE_ARG_TYPE_FLOAT)))
+        return aparse__defer_argument(ctx, arg, argv);
+
+    aparse__probe_begin(start);
+    status = aparse__convert_element(arg, argv, dest, size);
+    aparse__probe_end(ctx, APARSE__PHASE_CONVERT, start);
+    if(status != APARSE_STATUS_OK)
+        return aparse__raise_conversion(ctx, arg, argv, status);
+    return APARSE_STATUS_OK;
+}
+
+// Repeated options just append, lookups take the last record
+static aparse_status aparse__defer_argument(
+        aparse__context_t* ctx,
+        const aparse_arg* arg,
+        const char* argv)
+{
+    aparse_parser *parser = ctx->parser;
+    if(parser->deferred_count == parser->deferred_capacity)
+    {
+        const size_t capacity = parser->deferred_capacity ? 
+            parser->deferred_capacity * 2 : 16;
+        aparse__deferred_t *deferred = aparse_allocator_realloc(ctx->alloc, 
+                parser->deferred, 
+                parser->deferred_capacity * sizeof(aparse__deferred_t),
+                capacity * sizeof(aparse__deferred_t));
+        if(!deferred)
+            aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+        parser->deferred = deferred;
+        parser->deferred_capacity = capacity;
+    }
+    parser->deferred[parser->deferred_count++] = (aparse__deferred_t){
+        .arg = arg,
+        .value = argv
+    };
+    return APARSE_STATUS_OK;
+}
+
+// Widen the number at arg->ptr, after converting a pending value into it
+static aparse_status aparse__get_number(
+        aparse_parser* parser,
+        const aparse_arg* arg,
+        const aparse_arg_types type,
+        void* value)
+{
+    const int mask = APARSE_ARG_TYPE_BITMASK | APARSE_ARG_TYPE_SIGNED_FLAGS | 
+        APARSE_ARG_TYPE_ARRAY | APARSE_ARG_TYPE_ARGUMENT;
+    aparse__deferred_t *deferred = NULL;
+    uint64_t bits = 0;
+    if(!parser || !arg || !value || !arg->ptr)
+        return APARSE_STATUS_NULL_POINTER;
+    if((arg->type & mask) != (type | APARSE_ARG_TYPE_ARGUMENT))
+        return APARSE_STATUS_INVALID_TYPE;
+
+    for(size_t i = parser->deferred_count; i-- > 0;)
+    {
+        if(parser->deferred[i].arg == arg)
+        {
+            deferred = &parser->deferred[i];
+            break;
+        }
+    }
+    if(deferred && !deferred->converted)
+    {
+        deferred->status = aparse__convert_element(arg, deferred->value, 
+                arg->ptr, arg->size);
+        deferred->converted = true;
+    }
+    if(deferred && deferred->status != APARSE_STATUS_OK)
+        return deferred->status;
+
+    if(type == APARSE_ARG_TYPE_FLOAT)
+    {
+        if(arg->size == sizeof(float))
+            *(double*)value = *(const float*)arg->ptr;
+        else if(arg->size == sizeof(double))
+            *(double*)value = *(const double*)arg->ptr;
+        else if(arg->size == sizeof(long double))
+            *(double*)value = (double)*(const long double*)arg->ptr;
+        else
+            return APARSE_STATUS_UNHANDLED;
+        return APARSE_STATUS_OK;
+    }
+
+    if(arg->size == 0 || arg->size > sizeof(bits))
+        return APARSE_STATUS_INVALID_SIZE;
+    memcpy((uint8_t*)&bits + (APARSE_IS_LE ? 0 : sizeof(bits) - arg->size),
+            arg->ptr, arg->size);
+    if(type == APARSE_ARG_TYPE_SIGNED && arg->size < sizeof(bits))
+    {
+        // Sign-extend from the top bit of the destination
+        const uint64_t sign = (uint64_t)1 << (arg->size * 8 - 1);
+        bits = (bits ^ sign) - sign;
+    }
+    memcpy(value, &bits, sizeof(bits));
+    return APARSE_STATUS_OK;
+}
+
+static aparse_status aparse__process_parser(
+        const char* cargv,
+        const aparse_arg* arg,
+        const aparse__node_t* choices,
+        aparse__context_t* ctx)
+{
+    aparse_status ret = APARSE_STATUS_OK;
+    const aparse_arg *subparser = 0;
+    const aparse__node_t *child = 0;
+    uint8_t* buffer = 0;
+    int invalid_idx = 0;
+    size_t min_size = 0;
+
+    if(!arg->subargs)
+    {
+        aparse__raise_nonfatal(ctx, APARSE_STATUS_NULL_POINTER, 
+                arg, NULL);
+        return APARSE_STATUS_OK;
+    }
+    
+    if(choices && choices->index)
+    {
+        bool is_short = false, has_equal = false;
+        subparser = aparse__index_match(choices, cargv, 
+                &is_short, &has_equal);
+        if(has_equal)
+            subparser = NULL;
+    } else {
+        aparse__foreach(item, arg)
+        {
+            if(!strcmp(cargv, item->longopt))
+            {
+                subparser = item;
+                break;
             }
+        }
+    }
+    if(!subparser) 
+    {
+        aparse_list arg_list = { 
+            .ptr = (void*)(uintptr_t)arg->subargs, 
+            .itemsz = sizeof(aparse_arg) 
+        };
+        if(choices)
+            arg_list.size = choices->count;
+        else
+        {
+            for(const aparse_arg* copy = arg_list.ptr; aparse_arg_nend(copy); copy++)
+                arg_list.size++;
+        }
+        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SUBCOMMAND, 
+                &arg_list, cargv);
+    }
 
-            errno = 0;
-            char* endptr = 0;
-            uint64_t num = strtoull(p, &endptr, base);
-            
-            if(*endptr)
-                aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_VALUE, arg, argv);
-     
-            // Overflow/Underflow check No.1 (for 8 bytes)
-            if(errno == ERANGE)
+    if(!subparser->subargs)
+    {
+        if(!aparse_list_add(ctx->dispatch, 
+                (aparse__dispatch_t[1]){{subparser, NULL, 0}}))
+            aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+        return APARSE_STATUS_OK;
+    }
+
+    if(subparser->layout_size != 0)
+    {   
+        size_t last_idx = subparser->layout_size - 1;
+        aparse__probe_begin(start);
+        const bool valid = aparse__verify_layout(subparser, &invalid_idx);
+        aparse__probe_end(ctx, APARSE__PHASE_LAYOUT, start);
+        if(!valid)
+            aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_LAYOUT, subparser, &invalid_idx);
+        min_size =
+                subparser->data_layout[last_idx * 2] + 
+                subparser->data_layout[last_idx * 2 + 1];
+        if(!subparser->ptr || ctx->parser->batch)
+        {
+            buffer = aparse_allocator_alloc(ctx->alloc, min_size);
+            if(!buffer)
+                aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+            memset(buffer, 0, min_size);
+        } else {
+            if(subparser->size < min_size)
+                aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SIZE,
+                        subparser, &subparser->size);
+            buffer = subparser->ptr;
+        }
+    }
+
+    if(choices)
+        child = choices->children[subparser - arg->subargs];
+    ret = aparse__push_level(ctx, subparser->subargs, child);
+    if(ret == APARSE_STATUS_OK)
+    {
+        aparse__fill_args_dest(subparser, buffer, 
+                &ctx->stack[ctx->stack_top - 1]);
+        ret = aparse__parse_impl(ctx);
+        if(ret == APARSE_STATUS_OK)
+            ret = aparse__apply_env(ctx);
+        if(ret == APARSE_STATUS_OK)
+        {
+            aparse__probe_begin(start);
+            ret = aparse__check_missing(ctx);
+            aparse__probe_end(ctx, APARSE__PHASE_MISSING, start);
+        }
+        aparse__pop_level(ctx);
+    }
+
+    if(buffer == subparser->ptr)
+        min_size = 0; // not ours to release
+    if(!subparser->handler || ret != APARSE_STATUS_OK)
+    {
+        if(min_size)
+        {
+            aparse__destroy_payload(subparser, buffer);
+            aparse_allocator_free(ctx->alloc, buffer, min_size);
+        }
+    }
+    else {
+        if(!aparse_list_add(ctx->dispatch, 
+                (aparse__dispatch_t[1])
+                {{
+                    .args = subparser, 
+                    .payload = buffer,
+                    .payload_size = min_size
+                }}))
+        {
+            if(min_size)
             {
-                if(num == ULLONG_MAX || (int64_t)num == LLONG_MAX)
-                    aparse__raise_fatal(ctx, APARSE_STATUS_OVERFLOW, arg, argv);
-                if((int64_t)num == LLONG_MIN)
-                    aparse__raise_fatal(ctx, APARSE_STATUS_UNDERFLOW, arg, argv);
-            } else {
-                // Overflow/Underflow check No.2
-                size_t bits = arg->size * 8;
-                if (have_sign) {
-                    if(is_negative)
-                    {
-                        if(num > (uint64_t)INT64_MAX + 1ULL)
-                            aparse__raise_fatal(ctx, APARSE_STATUS_UNDERFLOW, arg, argv);
-                        if(num == (uint64_t)INT64_MAX + 1ULL)
-                            num = (uint64_t)INT64_MIN;
-                        else
-                            num = (uint64_t) -(int64_t)num;
-                    } else {
-                        int64_t min_val = 0;
-                        int64_t max_val = 0;
-
-                        if(num > (uint64_t)INT64_MAX)
-                            aparse__raise_fatal(ctx, APARSE_STATUS_OVERFLOW, arg, argv);
-                        min_val = bits == 64 ? INT64_MIN : -(1LL << (bits - 1));
-                        max_val = bits == 64 ? INT64_MAX :  (1LL << (bits - 1)) - 1;
-                        if ((int64_t)num < min_val || (int64_t)num > max_val)
-                            aparse__raise_fatal(ctx, APARSE_STATUS_OVERFLOW, arg, argv);
-                    }
-                } else {
-                    uint64_t max_val = bits == 64 ? UINT_MAX : ((1ULL << bits) - 1);
-                    if (num > max_val)
-                        aparse__raise_fatal(ctx, APARSE_STATUS_OVERFLOW, arg, argv);
-                }
+                aparse__destroy_payload(subparser, buffer);
+                aparse_allocator_free(ctx->alloc, buffer, min_size);
             }
+            aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+        }
+    }
+    return ret;
+}
+
+static aparse_status aparse_process_optional(
+        const aparse_arg* arg,
+        aparse__context_t *ctx)
+{
+    int *idx = &ctx->idx;
+    aparse__level_t *level = &ctx->stack[ctx->stack_top - 1];
+    aparse__slot_t *slot = aparse__level_slot(level, (size_t)(arg - level->args));
+    if(aparse__type_cmp(arg, APARSE_ARG_TYPE_BOOL))
+    {
+        bool was_set = false;
+        uint8_t *lsb = NULL;
+
+        if(slot->flags & APARSE__ARG_PROCESSED)
+            return APARSE_STATUS_FAILURE;
+        for(size_t i = 0; i < slot->size; i++)
+        {
+            if(((char*)slot->ptr)[i])
+                was_set = true;
+        }
+
+        // Attempting to set the LSB to 1
+        memset(slot->ptr, 0, slot->size);
+        lsb = (uint8_t*)slot->ptr + (APARSE_IS_LE ? 0 : slot->size - 1);
+        if(!was_set) 
+            *lsb |= 1;
+        slot->flags |= APARSE__ARG_PROCESSED;
+        return APARSE_STATUS_OK;
+    }
+    // if has equal
+    if(slot->flags & APARSE__ARG_EQUAL_VAL) 
+    {
+        const char* optname = (slot->flags & APARSE__ARG_SHORT_MATCH) ? 
+            arg->shortopt : arg->longopt;
+        return aparse__process_argument(
+                ctx->argv[*idx - 1] + 1 + strlen(optname), 
+                arg,
+                slot->ptr,
+                slot->size,
+                ctx);
+    }
+    else {
+        if(aparse__expand_response(ctx, *idx) != APARSE_STATUS_OK)
+            return APARSE_STATUS_FAILURE;
+        if(*idx >= ctx->argc) {
+            int expected_count = 1;
+            aparse__raise_fatal(ctx, APARSE_STATUS_MISSING_VALUE, arg, &expected_count);
+        }
+        (*idx)++;
+        return aparse__process_argument(
+                ctx->argv[*idx - 1], 
+                arg, 
+                slot->ptr,
+                slot->size,
+                ctx);
+    }
+}
+
+static aparse_status aparse__process_array(
+        const aparse_arg* arg, 
+        aparse__context_t *ctx)
+{
+    int *idx = &ctx->idx;
+    char* const *argv = NULL;
+    const aparse__level_t *level = &ctx->stack[ctx->stack_top - 1];
+    const aparse__slot_t *slot = aparse__level_slot(level, (size_t)(arg - level->args));
+    aparse_list* dest = slot->ptr;
+    size_t arrsz = 0, increment = 0;
+    uint8_t *ptr = 0;
+
+    if(!dest)
+        aparse__raise_fatal(ctx, APARSE_STATUS_NULL_POINTER, arg, 0);
+    if(slot->size < aparse__eval_size(arg))
+        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SIZE, arg, &slot->size);
+    if((arg->type & APARSE_ARG_TYPE_BITMASK) == APARSE_ARG_TYPE_UNKNOWN)
+        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_TYPE, arg, 0);
+
+    if(arg->array_max && arg->array_max < arg->array_size)
+        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SIZE, arg, &arg->array_max);
 
-            memcpy(arg->ptr, 
-                    (uint8_t*)&num + (APARSE_IS_LE ? 0 : 8 - arg->size), arg->size);
+    (*idx)--;
+    if(aparse__array_extent(arg, ctx, &arrsz) != APARSE_STATUS_OK)
+        return APARSE_STATUS_FAILURE;
+    argv = ctx->argv;
+    increment = aparse__type_cmp(arg, APARSE_ARG_TYPE_STRING) ? 
+        sizeof(char*) : 
+        arg->element_size;
+    if(increment <= 0 || (increment < sizeof(aparse_string_view) && 
+                aparse__type_cmp(arg, APARSE_ARG_TYPE_STRING_VIEW)))
+        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SIZE, arg, &arg->element_size);
 
-            if (have_sign) {
-                uint8_t* msb = (uint8_t*)arg->ptr + 
-                    (APARSE_IS_LE ? arg->size - 1 : 0);
-                *msb = (uint8_t)((*msb & ~0x80) | (((int64_t)num < 0) ? 0x80 : 0));
+    if(arrsz < arg->array_size)
+    {
+        const int expected_count = (int)arg->array_size;
+        aparse__raise_fatal(ctx, APARSE_STATUS_MISSING_VALUE, arg, &expected_count);
+    }
+    if(arg->type & APARSE_ARG_TYPE_STREAM)
+        return aparse__process_stream(arg, slot->ptr, argv + *idx, 
+                arrsz, increment, ctx);
+    
+    if(ctx->parser->no_alloc && dest->ptr && dest->capacity)
+    {
+        // Caller-provided storage, never grown. The caller keeps owning it,
+        // so releasing the list (or its payload) frees nothing.
+        if(dest->itemsz != increment)
+            aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SIZE, arg, &dest->itemsz);
+        if(arrsz > dest->capacity)
+            aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+        aparse__list_fixed(dest, dest->ptr, dest->capacity);
+        ptr = dest->ptr;
+    } else {
+        ptr = aparse_allocator_alloc(ctx->alloc, increment * arrsz);
+        if(!ptr)
+            aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+        dest->allocator = ctx->backing;
+        dest->ptr = ptr;
+        dest->itemsz = increment;
+        dest->capacity = arrsz;
+    }
+    dest->size = 0;
+    if(ctx->parser->threads > 1 && arrsz >= ctx->parser->thread_threshold)
+    {
+        aparse__probe_begin(start);
+        aparse_status status = aparse__convert_parallel(arg, argv + *idx,
+                ptr, arrsz, increment, &dest->size, ctx);
+        aparse__probe_end(ctx, APARSE__PHASE_CONVERT, start);
+        *idx += (int)dest->size;
+        return status;
+    }
+    while(dest->size < arrsz)
+    {
+        size_t converted = 0;
+        aparse__probe_begin(start);
+        aparse_status status = aparse__convert_elements(arg, argv + *idx, 
+                ptr + dest->size * increment, arrsz - dest->size, 
+                increment, &converted);
+        aparse__probe_end(ctx, APARSE__PHASE_CONVERT, start);
+        dest->size += converted;
+        *idx += (int)converted;
+        if(status == APARSE_STATUS_OK)
+            break;
+        if(aparse__raise_conversion(ctx, arg, argv[*idx], status) != APARSE_STATUS_OK)
+            return APARSE_STATUS_FAILURE;
+        // Skip the element that underflowed
+        dest->size++;
+        (*idx)++;
+    }
+    return APARSE_STATUS_OK;
+}
+
+// Number of elements starting at ctx->idx: the tokens up to the next
+// recognized option, at most array_max of them. Response files are
+// expanded on the way, so the count covers their tokens too.
+static aparse_status aparse__array_extent(
+        const aparse_arg* arg,
+        aparse__context_t *ctx,
+        size_t* count)
+{
+    const size_t max = arg->array_max ? arg->array_max : SIZE_MAX;
+    int i = ctx->idx + 1; // the first element was already matched
+
+    while(i < ctx->argc && (size_t)(i - ctx->idx) < max)
+    {
+        if(aparse__expand_response(ctx, i) != APARSE_STATUS_OK)
+            return APARSE_STATUS_FAILURE;
+        if(i >= ctx->argc || aparse__is_option(ctx->argv[i], ctx))
+            break;
+        i++;
+    }
+    *count = (size_t)(i - ctx->idx);
+    return APARSE_STATUS_OK;
+}
+
+static aparse_status aparse__process_stream(
+        const aparse_arg* arg,
+        const aparse_stream* desc,
+        char* const* argv,
+        const size_t count,
+        const size_t increment,
+        aparse__context_t *ctx)
+{
+    _Alignas(max_align_t) uint8_t chunk[APARSE__STREAM_CHUNK];
+    // Batch parses only check the values, callbacks and buffers are shared
+    const aparse_stream discard = {
+        .callback = aparse__stream_discard,
+        .batch = desc->batch
+    };
+    if(ctx->parser->batch && desc->callback)
+        desc = &discard;
+    aparse__stream_t stream = {
+        .arg = arg,
+        .desc = desc,
+        .buffer = desc->buffer ? desc->buffer : chunk,
+        .batch = desc->batch ? desc->batch : 1,
+        .increment = increment
+    };
+    aparse_status status = APARSE_STATUS_OK;
+
+    if(!desc->callback)
+        aparse__raise_fatal(ctx, APARSE_STATUS_NULL_POINTER, arg, 0);
+    if(!desc->buffer)
+        stream.batch = APARSE__MIN(stream.batch, sizeof(chunk) / increment);
+    if(stream.batch == 0)
+        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SIZE, arg, &arg->element_size);
+
+    if(count == 1 && !strcmp(argv[0], "-"))
+        status = ctx->parser->batch ? 
+            APARSE_STATUS_OK : aparse__stream_stdin(ctx, &stream);
+    else
+        status = aparse__stream_push(ctx, &stream, argv, count);
+    if(status != APARSE_STATUS_OK || !aparse__stream_flush(&stream))
+        return APARSE_STATUS_FAILURE;
+    ctx->idx += (int)count;
+    return APARSE_STATUS_OK;
+}
+
+static aparse_status aparse__stream_push(
+        aparse__context_t* ctx,
+        aparse__stream_t* stream,
+        char* const* tokens,
+        const size_t count)
+{
+    size_t i = 0;
+
+    while(i < count)
+    {
+        size_t converted = 0;
+        aparse__probe_begin(start);
+        aparse_status status = aparse__convert_elements(stream->arg, tokens + i, 
+                stream->buffer + stream->filled * stream->increment, 
+                APARSE__MIN(stream->batch - stream->filled, count - i),
+                stream->increment, &converted);
+        aparse__probe_end(ctx, APARSE__PHASE_CONVERT, start);
+        stream->filled += converted;
+        i += converted;
+        if(status != APARSE_STATUS_OK)
+        {
+            // Only an underflowing float goes on, without its value
+            if(aparse__raise_conversion(ctx, stream->arg, 
+                        tokens[i], status) != APARSE_STATUS_OK)
+                return APARSE_STATUS_FAILURE;
+            i++;
+        }
+        if(stream->filled == stream->batch && !aparse__stream_flush(stream))
+            return APARSE_STATUS_FAILURE;
+    }
+    return APARSE_STATUS_OK;
+}
+
+static bool aparse__stream_flush(
+        aparse__stream_t* stream)
+{
+    bool ok = stream->filled == 0 || 
+        stream->desc->callback(stream->arg, stream->buffer, 
+                stream->filled, stream->desc->userdata);
+    stream->filled = 0;
+    return ok;
+}
+
+static bool aparse__stream_discard(
+        const aparse_arg* arg, 
+        const void* values, 
+        size_t count, 
+        void* userdata)
+{
+    (void)arg;
+    (void)values;
+    (void)count;
+    (void)userdata;
+    return true;
+}
+
+// Whitespace-separated values until the end of stdin, read in chunks
+static aparse_status aparse__stream_stdin(
+        aparse__context_t* ctx,
+        aparse__stream_t* stream)
+{
+    char input[APARSE__STREAM_INPUT];
+    char *tokens[APARSE__STREAM_TOKENS];
+    size_t len = 0, count = 0;
+    bool eof = false;
+
+    while(!eof)
+    {
+        size_t pos = 0, start = 0;
+
+        len += fread(input + len, 1, sizeof(input) - 1 - len, stdin);
+        eof = len < sizeof(input) - 1;
+        while(true)
+        {
+            while(pos < len && isspace((unsigned char)input[pos]))
+                pos++;
+            start = pos;
+            while(pos < len && !isspace((unsigned char)input[pos]))
+                pos++;
+            // A value touching the end may continue in the next read
+            if(start == len || (pos == len && !eof))
+                break;
+            input[pos] = '\0';
+            pos += pos < len;
+            tokens[count++] = input + start;
+            if(count == APARSE__STREAM_TOKENS)
+            {
+                if(aparse__stream_push(ctx, stream, tokens, count) != APARSE_STATUS_OK)
+                    return APARSE_STATUS_FAILURE;
+                count = 0;
             }
+        }
+        if(aparse__stream_push(ctx, stream, tokens, count) != APARSE_STATUS_OK)
+            return APARSE_STATUS_FAILURE;
+        count = 0;
+        // Strings point into input, which is about to be overwritten
+        if((aparse__type_cmp(stream->arg, APARSE_ARG_TYPE_STRING) ||
+                    aparse__type_cmp(stream->arg, APARSE_ARG_TYPE_STRING_VIEW)) && 
+                !aparse__stream_flush(stream))
+            return APARSE_STATUS_FAILURE;
+
+        if(start == 0 && len == sizeof(input) - 1)
+        {
+            input[len] = '\0';
+            aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_VALUE, 
+                    stream->arg, input);
+        }
+        memmove(input, input + start, len - start);
+        len -= start;
+    }
+    if(ferror(stdin))
+        aparse__raise_fatal(ctx, APARSE_STATUS_RESPONSE_FILE, "-", 0);
+    return APARSE_STATUS_OK;
+}
+
+static void aparse__convert_task_run(
+        void* userdata)
+{
+    aparse__convert_task_t *task = userdata;
+    size_t i = 0;
+
+    while(i < task->count)
+    {
+        size_t converted = 0;
+        aparse_status status = aparse__convert_elements(task->arg, 
+                task->argv + i, task->dest + i * task->increment, 
+                task->count - i, task->increment, &converted);
+        i += converted;
+        if(status == APARSE_STATUS_OK)
             break;
+        if(status != APARSE_STATUS_UNDERFLOW ||
+                !aparse__type_cmp(task->arg, APARSE_ARG_TYPE_FLOAT))
+        {
+            task->failed = i;
+            task->status = status;
+            return;
         }
-        case APARSE_ARG_TYPE_FLOAT:
+        task->underflows++;
+        i++;
+    }
+}
+
+// Convert count elements in chunks, one per thread, then report errors in
+// argv order as the serial conversion would
+static aparse_status aparse__convert_parallel(
+        const aparse_arg* arg,
+        char* const* argv,
+        uint8_t* dest,
+        const size_t count,
+        const size_t increment,
+        size_t* converted,
+        aparse__context_t *ctx)
+{
+    aparse__convert_task_t tasks[APARSE__MAX_THREADS];
+    size_t workers = APARSE__MIN((size_t)ctx->parser->threads, count);
+    size_t chunk = (count + workers - 1) / workers, begin = 0;
+#ifndef APARSE_NO_THREADS
+    aparse__thread_t threads[APARSE__MAX_THREADS];
+    bool started[APARSE__MAX_THREADS] = {0};
+#endif
+
+    for(size_t i = 0; i < workers; i++, begin += chunk)
+    {
+        tasks[i] = (aparse__convert_task_t){
+            .arg = arg,
+            .argv = argv + begin,
+            .dest = dest + begin * increment,
+            .count = APARSE__MIN(chunk, count - begin),
+            .increment = increment
+        };
+        tasks[i].failed = tasks[i].count;
+    }
+
+#ifndef APARSE_NO_THREADS
+    for(size_t i = 1; i < workers; i++)
+        started[i] = aparse__thread_start(&threads[i], 
+                aparse__convert_task_run, &tasks[i]);
+#endif
+    aparse__convert_task_run(&tasks[0]);
+    for(size_t i = 1; i < workers; i++)
+    {
+#ifndef APARSE_NO_THREADS
+        if(started[i])
+        {
+            aparse__thread_join(&threads[i]);
+            continue;
+        }
+#endif
+        aparse__convert_task_run(&tasks[i]);
+    }
+
+    *converted = 0;
+    for(size_t i = 0; i < workers; i++)
+    {
+        aparse__convert_task_t *task = &tasks[i];
+        // Underflows leave the element untouched, find them again
+        for(size_t j = 0; task->underflows && j < task->failed; j++)
+        {
+            if(aparse__convert_element(arg, task->argv[j], 
+                        task->dest + j * increment, 
+                        arg->element_size) == APARSE_STATUS_UNDERFLOW)
+            {
+                aparse__raise_nonfatal(ctx, APARSE_STATUS_UNDERFLOW, 
+                        arg, task->argv[j]);
+                task->underflows--;
+            }
+        }
+        *converted += task->failed;
+        if(task->failed < task->count)
+            return aparse__raise_conversion(ctx, arg, 
+                    task->argv[task->failed], task->status);
+    }
+    return APARSE_STATUS_OK;
+}
+
+#ifndef APARSE_NO_THREADS
+#   ifdef _WIN32
+static DWORD WINAPI aparse__thread_entry(
+        LPVOID userdata)
+{
+    aparse__thread_t *thread = userdata;
+    thread->fn(thread->userdata);
+    return 0;
+}
+#   else
+static void* aparse__thread_entry(
+        void* userdata)
+{
+    aparse__thread_t *thread = userdata;
+    thread->fn(thread->userdata);
+    return NULL;
+}
+#   endif
+
+static bool aparse__thread_start(
+        aparse__thread_t* thread,
+        void (*fn)(void*),
+        void* userdata)
+{
+    thread->fn = fn;
+    thread->userdata = userdata;
+#   ifdef _WIN32
+    thread->handle = CreateThread(NULL, 0, aparse__thread_entry, thread, 0, NULL);
+    return thread->handle != NULL;
+#   else
+    return pthread_create(&thread->handle, NULL, aparse__thread_entry, thread) == 0;
+#   endif
+}
+
+static void aparse__thread_join(
+        aparse__thread_t* thread)
+{
+#   ifdef _WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#   else
+    pthread_join(thread->handle, NULL);
+#   endif
+}
+#endif
+
+static void aparse__mutex_init(aparse__mutex_t* mutex)
+{
+#ifdef APARSE_NO_THREADS
+    (void)mutex;
+#elif defined(_WIN32)
+    InitializeSRWLock(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+static void aparse__mutex_destroy(aparse__mutex_t* mutex)
+{
+#if defined(APARSE_NO_THREADS) || defined(_WIN32)
+    (void)mutex;
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+static void aparse__mutex_lock(aparse__mutex_t* mutex)
+{
+#ifdef APARSE_NO_THREADS
+    (void)mutex;
+#elif defined(_WIN32)
+    AcquireSRWLockExclusive(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+static void aparse__mutex_unlock(aparse__mutex_t* mutex)
+{
+#ifdef APARSE_NO_THREADS
+    (void)mutex;
+#elif defined(_WIN32)
+    ReleaseSRWLockExclusive(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+static void aparse__cond_init(aparse__cond_t* cond)
+{
+#ifdef APARSE_NO_THREADS
+    (void)cond;
+#elif defined(_WIN32)
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+static void aparse__cond_destroy(aparse__cond_t* cond)
+{
+#if defined(APARSE_NO_THREADS) || defined(_WIN32)
+    (void)cond;
+#else
+    pthread_cond_destroy(cond);
+#endif
+}
+
+// Without threads nobody could wake us up, the schedule never waits then
+static void aparse__cond_wait(aparse__cond_t* cond, aparse__mutex_t* mutex)
+{
+#ifdef APARSE_NO_THREADS
+    (void)cond;
+    (void)mutex;
+#elif defined(_WIN32)
+    SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+static void aparse__cond_broadcast(aparse__cond_t* cond)
+{
+#ifdef APARSE_NO_THREADS
+    (void)cond;
+#elif defined(_WIN32)
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+// Replace the token at index by the content of the response file it names,
+// until it is an ordinary token. A lone "@" is taken literally.
+static aparse_status aparse__expand_response(
+        aparse__context_t* ctx,
+        const int index)
+{
+    aparse_parser *parser = ctx->parser;
+
+    while(parser->response_files && index < ctx->argc && 
+            ctx->argv[index][0] == '@' && ctx->argv[index][1])
+    {
+        const char *path = ctx->argv[index] + 1;
+        aparse__response_t *response = NULL;
+        char **tokens = NULL, *token = NULL;
+        size_t count = 0, size = 0;
+
+        if(parser->response_count >= APARSE__MAX_RESPONSE_FILES)
+            aparse__raise_fatal(ctx, APARSE_STATUS_TOO_DEEP, 0, 0);
+        response = &parser->responses[parser->response_count];
+        if(!aparse__load_response(ctx, path, response))
+            aparse__raise_fatal(ctx, APARSE_STATUS_RESPONSE_FILE, path, 0);
+        parser->response_count++;
+
+        count = aparse__tokenize(response->base, response->size);
+        if(count > (size_t)INT32_MAX - (size_t)ctx->argc)
+            aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+        size = (size_t)ctx->argc - 1 + count;
+        tokens = aparse_allocator_alloc(ctx->alloc, size * sizeof(char*));
+        if(!tokens)
+            aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+
+        memcpy(tokens, ctx->argv, (size_t)index * sizeof(char*));
+        token = response->base;
+        for(size_t i = 0; i < count; i++)
         {
-            aparse_status status = aparse__process_float(argv, arg);
-            if(status != APARSE_STATUS_OK)
-            {
-                if(status != APARSE_STATUS_UNDERFLOW)
-                    aparse__raise_fatal(ctx, status, arg, argv)
-                else
-                    aparse__raise_nonfatal(ctx, status, arg, argv);
-            }
-            break;
+            tokens[(size_t)index + i] = token;
+            token += strlen(token) + 1;
         }
-        default:
-            aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_TYPE, arg, 0);
+        memcpy(tokens + (size_t)index + count, ctx->argv + index + 1, 
+                (size_t)(ctx->argc - index - 1) * sizeof(char*));
+
+        aparse_allocator_free(ctx->alloc, ctx->tokens, 
+                ctx->tokens_size * sizeof(char*));
+        ctx->tokens = tokens;
+        ctx->tokens_size = size;
+        ctx->argv = tokens;
+        ctx->argc = (int)size;
     }
     return APARSE_STATUS_OK;
 }
 
-
-static aparse_status aparse__process_parser(
-        const int argc,
-        const char* cargv,
-        char* const* argv,
-        aparse_arg* arg,
-        aparse__context_t* ctx)
+// Map the file copy-on-write, with at least one zero byte after its end
+static bool aparse__load_response(
+        aparse__context_t* ctx,
+        const char* path,
+        aparse__response_t* response)
 {
-    aparse_status ret = APARSE_STATUS_OK;
-    aparse_arg *subparser = 0;
-    uint8_t* buffer = 0;
-    int invalid_idx = 0;
-    size_t min_size = 0;
+    size_t page = 0;
+    FILE *file = NULL;
+    bool loaded = false;
 
-    if(!arg->subargs)
-    {
-        aparse__raise_nonfatal(ctx, APARSE_STATUS_NULL_POINTER, 
-                arg, NULL);
-        return APARSE_STATUS_OK;
-    }
-    
-    aparse__foreach(item, arg)
+    *response = (aparse__response_t){0};
+#ifdef _WIN32
     {
-        if(!strcmp(cargv, item->longopt))
+        SYSTEM_INFO info;
+        LARGE_INTEGER size;
+        HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 
+                NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if(handle == INVALID_HANDLE_VALUE)
+            return false;
+        GetSystemInfo(&info);
+        page = info.dwPageSize;
+        if(GetFileSizeEx(handle, &size) && (uint64_t)size.QuadPart < SIZE_MAX)
         {
-            subparser = item;
-            break;
+            response->size = (size_t)size.QuadPart;
+            if(response->size == 0)
+                loaded = true;
+            else if(response->size % page != 0)
+            {
+                HANDLE mapping = CreateFileMappingA(handle, NULL, 
+                        PAGE_WRITECOPY, 0, 0, NULL);
+                if(mapping)
+                {
+                    response->base = MapViewOfFile(mapping, FILE_MAP_COPY, 
+                            0, 0, 0);
+                    response->mapped = loaded = response->base != NULL;
+                    CloseHandle(mapping);
+                }
+            }
         }
+        CloseHandle(handle);
+        if(loaded || response->size == 0 || response->size % page != 0)
+            return loaded;
     }
-    if(!subparser) 
-    {
-        aparse_list arg_list = { .ptr = (void*)arg->subargs };
-        for(aparse_arg* copy = arg_list.ptr; aparse_arg_nend(copy); copy++)
-            arg_list.size++;
-        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SUBCOMMAND, 
-                &arg_list, cargv);
-    }
-
-    if(!subparser->subargs)
+#else
     {
-        aparse_list_add(ctx->dispatch, 
-                (aparse__dispatch_t[1]){{subparser, NULL}});
-        return APARSE_STATUS_OK;
-    }
-
-    if(subparser->layout_size != 0)
-    {   
-        size_t last_idx = subparser->layout_size - 1;
-        if(!aparse__verify_layout(subparser, &invalid_idx))
-            aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_LAYOUT, subparser, &invalid_idx);
-        min_size =
-                subparser->data_layout[last_idx * 2] + 
-                subparser->data_layout[last_idx * 2 + 1];
-        if(!subparser->ptr)
+        struct stat st;
+        int fd = open(path, O_RDONLY);
+        if(fd < 0)
+            return false;
+        page = (size_t)sysconf(_SC_PAGESIZE);
+        if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
         {
-            buffer = calloc(min_size, sizeof(*buffer));
-            if(!buffer)
-                aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
-        } else {
-            if(subparser->size < min_size)
-                aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SIZE,
-                        subparser, &subparser->size);
-            buffer = subparser->ptr;
+            response->size = (size_t)st.st_size;
+            if(response->size == 0)
+                loaded = true;
+            else if(response->size % page != 0)
+            {
+                void *base = mmap(NULL, response->size, 
+                        PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+                response->base = base == MAP_FAILED ? NULL : base;
+                response->mapped = loaded = response->base != NULL;
+            }
         }
+        close(fd);
+        if(loaded || response->size == 0 || response->size % page != 0)
+            return loaded;
     }
+#endif
 
-    aparse__fill_args_dest(subparser, buffer);
-
-    ret = aparse__parse_impl(argc, argv, subparser->subargs, ctx);
-    if(ret == APARSE_STATUS_OK)
-        ret = aparse__check_missing(ctx, subparser->subargs);
-
-    if(!subparser->handler || ret != APARSE_STATUS_OK)
-        free(buffer);
-    else {
-        aparse_list_add(ctx->dispatch, 
-                (aparse__dispatch_t[1])
-                {{
-                    .args = subparser, 
-                    .payload = buffer
-                }});
-    }
-    return ret;
-}
-
-static aparse_status aparse_process_optional(
-        const int argc, 
-        char* const* argv, 
-        aparse_arg* arg,
-        aparse__context_t *ctx)
-{
-    int *idx = &ctx->idx;
-    if(aparse__type_cmp(arg, APARSE_ARG_TYPE_BOOL))
+    // Filling the last page exactly leaves no room for a terminator
+    response->owned = !ctx->parser->no_alloc;
+    response->base = aparse_allocator_alloc(
+            response->owned ? NULL : ctx->backing, response->size + 1);
+    file = response->base ? fopen(path, "rb") : NULL;
+    if(file)
     {
-        bool was_set = false;
-        uint8_t *lsb = NULL;
-
-        if(arg->flags & APARSE__ARG_PROCESSED)
-            return APARSE_STATUS_FAILURE;
-        for(size_t i = 0; i < arg->size; i++)
-        {
-            if(((char*)arg->ptr)[i])
-                was_set = true;
-        }
-
-        // Attempting to set the LSB to 1
-        memset(arg->ptr, 0, arg->size);
-        lsb = (uint8_t*)arg->ptr + (APARSE_IS_LE ? 0 : arg->size - 1);
-        if(!was_set) 
-            *lsb |= 1;
-        arg->flags |= APARSE__ARG_PROCESSED;
-        return APARSE_STATUS_OK;
+        loaded = fread(response->base, 1, response->size, file) == 
+            response->size;
+        fclose(file);
     }
-    // if has equal
-    if(arg->flags & APARSE__ARG_EQUAL_VAL) 
+    if(!loaded)
     {
-        const char* optname = (arg->flags & APARSE__ARG_SHORT_MATCH) ? 
-            arg->shortopt : arg->longopt;
-        return aparse__process_argument(
-                argv[*idx - 1] + 1 + strlen(optname), 
-                arg,
-                ctx);
-    }
-    else {
-        if(*idx >= argc) {
-            int expected_count = 1;
-            aparse__raise_fatal(ctx, APARSE_STATUS_MISSING_VALUE, arg, &expected_count);
-        }
-        (*idx)++;
-        return aparse__process_argument(
-                argv[*idx - 1], 
-                arg, 
-                ctx);
+        if(response->owned)
+            aparse_allocator_free(NULL, response->base, response->size + 1);
+        *response = (aparse__response_t){0};
     }
+    return loaded;
 }
 
-static aparse_status aparse__process_float(
-        const char* argv, 
-        const aparse_arg* arg)
+// Split buffer into tokens separated by whitespace, with '' or "" quoting
+// and \ escaping, and pack them NUL-terminated at its start. Writing never
+// passes reading, except for the terminator of a token ending the buffer.
+static size_t aparse__tokenize(
+        char* buffer,
+        const size_t size)
 {
-    char* endptr = 0;
-    errno = 0;
-    long double num = strtold(argv, &endptr);
-    long double abs_val = fabsl(num);
-
-    if(*endptr)
-        return APARSE_STATUS_INVALID_VALUE;
-    
-    if(errno == ERANGE)
-    {
-        if((num == HUGE_VALL || num == -HUGE_VALL))
-            return APARSE_STATUS_OVERFLOW;
-        if(num == 0.0 || abs_val < LDBL_MIN)
-            return APARSE_STATUS_UNDERFLOW;
-    }
+    const char *in = buffer, *end = buffer + size;
+    char *out = buffer;
+    size_t count = 0;
 
-    switch (arg->size) 
+    while(true)
     {
-        case sizeof(float):
-            if (abs_val > FLT_MAX && abs_val != INFINITY)
-                return APARSE_STATUS_OVERFLOW;
-            if (num != 0.0L && abs_val < FLT_MIN)
-                return APARSE_STATUS_UNDERFLOW;
-            *(float *)arg->ptr = (float)num;
-            break;
-
-        case sizeof(double):
-            if (abs_val > DBL_MAX && abs_val != INFINITY)
-                return APARSE_STATUS_OVERFLOW;
-            if (num != 0.0L && abs_val < DBL_MIN)
-                return APARSE_STATUS_UNDERFLOW;
-            *(double *)arg->ptr = (double)num;
+        char quote = 0;
+        while(in < end && isspace((unsigned char)*in))
+            in++;
+        if(in >= end)
             break;
-
-        case sizeof(long double):
-            *(long double *)arg->ptr = num;
-            break;
-
-        default:
-            return APARSE_STATUS_UNHANDLED;
+        while(in < end && (quote || !isspace((unsigned char)*in)))
+        {
+            char c = *in++;
+            if(c == '\\' && in < end)
+                *out++ = *in++;
+            else if(quote ? c == quote : c == '"' || c == '\'')
+                quote = quote ? 0 : c;
+            else
+                *out++ = c;
+        }
+        in += in < end; // the separator, before the terminator may overwrite it
+        *out++ = '\0';
+        count++;
     }
-    return 0;
+    return count;
 }
 
-static aparse_status aparse__process_array(
-        const int argc, 
-        char* const * argv, 
-        aparse_arg* arg, 
-        aparse__context_t *ctx)
+static void aparse__release_responses(
+        aparse_parser* parser)
 {
-    int *idx = &ctx->idx;
-    aparse_list* dest = arg->ptr;
-    size_t arrsz = 0, increment = 0;
-    void *ptr = 0;
-
-    if(!dest)
-        aparse__raise_fatal(ctx, APARSE_STATUS_NULL_POINTER, arg, 0);
-    if(arg->size < sizeof(aparse_list))
-        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SIZE, arg, &arg->size);
-    if((arg->type & APARSE_ARG_TYPE_BITMASK) == APARSE_ARG_TYPE_UNKNOWN)
-        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_TYPE, arg, 0);
-
-    (*idx)--;
-    arrsz = (size_t)(argc - *idx);
-    increment = arg->type & APARSE_ARG_TYPE_STRING ? 
-        sizeof(char*) : 
-        arg->element_size;
-    if(increment <= 0)
-        aparse__raise_fatal(ctx, APARSE_STATUS_INVALID_SIZE, arg, &arg->element_size);
-
-    if(arrsz < arg->array_size)
-        aparse__raise_fatal(ctx, APARSE_STATUS_MISSING_VALUE, arg, &arrsz);
-    
-    ptr = malloc(increment * arrsz);
-    if(!ptr)
-        aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
-    dest->capacity = arrsz;
-    dest->ptr = ptr;
-    dest->itemsz = increment;
-    arg->ptr = ptr;
-    arg->size = arg->element_size;
-    while(dest->size < dest->capacity)
-    {
-        if(aparse__process_argument(
-                    argv[(*idx)], 
-                    arg,
-                    ctx) != APARSE_STATUS_OK)
-            return APARSE_STATUS_FAILURE;
-        dest->size++;
-        (*idx)++; 
-        arg->ptr = (uint8_t*)arg->ptr + increment;
+    for(size_t i = 0; i < parser->response_count; i++)
+    {
+        aparse__response_t *response = &parser->responses[i];
+        if(response->mapped)
+        {
+#ifdef _WIN32
+            UnmapViewOfFile(response->base);
+#else
+            munmap(response->base, response->size);
+#endif
+        } else if(response->owned)
+            aparse_allocator_free(NULL, response->base, response->size + 1);
     }
-    // re-assign to prevent SIGSEGV in aparse_destroy_data
-    arg->ptr = dest;
-    return APARSE_STATUS_OK;
+    parser->response_count = 0;
 }
 
 // Use to evaluate the size of given argument, therefore checking it with data layout
 static size_t aparse__eval_size(
         const aparse_arg* arg)
 {
+    if(arg->type & APARSE_ARG_TYPE_STREAM)
+        return sizeof(aparse_stream);
     if(arg->type & APARSE_ARG_TYPE_ARRAY)
         return sizeof(aparse_list);
     if(arg->size == 0 && aparse__type_cmp(arg, APARSE_ARG_TYPE_STRING))
@@ -900,76 +2873,474 @@ static bool aparse__verify_layout(
     return true;
 }
 
-static int aparse__fill_args_dest(
+static void aparse__fill_args_dest(
         const aparse_arg* arg, 
-        uint8_t *buffer)
+        uint8_t *buffer,
+        aparse__level_t *level)
 {
-    size_t layout_size = 0;
-    aparse_arg *arg_ptr = 0;
     if(!buffer)
-        return APARSE_STATUS_OK;
-
-    layout_size = arg->layout_size;
-    if(layout_size == 0)
-        return APARSE_STATUS_OK;
+        return;
 
-    arg_ptr = arg->subargs;
-    for(size_t i = 0; i < layout_size && aparse_arg_nend(arg_ptr); 
-            i++, arg_ptr++)
+    for(size_t i = 0; i < arg->layout_size && i < level->count; i++)
     {
-        size_t offset = 0;
-        if(!aparse__is_argument(arg_ptr))
-            continue;
-        offset  = arg->data_layout[i * 2];
-
-        if(arg_ptr->ptr)
+        const aparse_arg *arg_ptr = &level->args[i];
+        aparse__slot_t *slot = aparse__level_slot(level, i);
+        if(!aparse__is_argument(arg_ptr) || arg_ptr->ptr)
             continue;
         
-        arg_ptr->ptr = &buffer[offset];
+        slot->ptr = &buffer[arg->data_layout[i * 2]];
         if(arg_ptr->size == 0 && 
                 aparse__type_cmp(arg_ptr, APARSE_ARG_TYPE_STRING))
             continue;
-        arg_ptr->size = aparse__eval_size(arg_ptr);
+        slot->size = aparse__eval_size(arg_ptr);
     }
-    return APARSE_STATUS_OK;
 }
 
 static void aparse__destroy_payload(
         const aparse_arg *args, 
         uint8_t *payload)
 {
+    const aparse_arg *sa = 0;
     if(!args || !payload)
         return;
-    aparse__foreach(sa, args)
+    sa = args->subargs;
+    for(size_t i = 0; aparse_arg_nend(sa); i++, sa++)
+    {
+        const aparse_list *list = sa->ptr;
+        if(!(sa->type & APARSE_ARG_TYPE_ARRAY) || 
+                sa->type & APARSE_ARG_TYPE_STREAM)
+            continue;
+        if(!list && i < args->layout_size)
+            list = (const aparse_list*)&payload[args->data_layout[i * 2]];
+        if(list)
+            aparse_allocator_free(list->allocator, list->ptr, 
+                    list->capacity * list->itemsz);
+    }
+}
+
+static void aparse__dispatch_release(
+        const aparse_allocator* alloc,
+        aparse__dispatch_t* entry)
+{
+    aparse__destroy_payload(entry->args, entry->payload);
+    if(entry->payload_size)
+        aparse_allocator_free(alloc, entry->payload, entry->payload_size);
+    entry->payload = NULL;
+}
+
+// Dependency edges as (before, after) pairs, only counted when pairs is NULL
+static size_t aparse__pool_edges(
+        const aparse__pool_t* pool,
+        const aparse_dispatch_dep* deps,
+        const size_t dep_count,
+        size_t* pairs)
+{
+    size_t edges = 0;
+    for(size_t d = 0; d < dep_count; d++)
+    {
+        if(!deps[d].name || !deps[d].after)
+            continue;
+        for(size_t i = 0; i < pool->count; i++)
+        {
+            const char *name = pool->entries[i].args->longopt;
+            if(!name || strcmp(name, deps[d].name))
+                continue;
+            for(size_t j = 0; j < pool->count; j++)
+            {
+                const char *after = pool->entries[j].args->longopt;
+                if(j == i || !after || strcmp(after, deps[d].after))
+                    continue;
+                if(pairs)
+                {
+                    pairs[edges * 2] = j;
+                    pairs[edges * 2 + 1] = i;
+                }
+                edges++;
+            }
+        }
+    }
+    return edges;
+}
+
+// Build the dependents of each entry, then check that every entry can
+// become ready (no cycle) by running the schedule once serially
+static bool aparse__pool_build(
+        aparse__pool_t* pool,
+        const size_t* pairs,
+        const size_t edges,
+        size_t* scratch)
+{
+    const size_t count = pool->count;
+    size_t *pending = pool->workers[0].items; // free until the deques are filled
+    size_t head = 0, tail = 0;
+
+    memset(pool->pending, 0, count * sizeof(size_t));
+    memset(pool->first, 0, (count + 1) * sizeof(size_t));
+    for(size_t e = 0; e < edges; e++)
+    {
+        pool->first[pairs[e * 2] + 1]++;
+        pool->pending[pairs[e * 2 + 1]]++;
+    }
+    for(size_t i = 0; i < count; i++)
+        pool->first[i + 1] += pool->first[i];
+    memcpy(scratch, pool->first, count * sizeof(size_t));
+    for(size_t e = 0; e < edges; e++)
+        pool->dependents[scratch[pairs[e * 2]]++] = pairs[e * 2 + 1];
+
+    memcpy(pending, pool->pending, count * sizeof(size_t));
+    for(size_t i = 0; i < count; i++)
+    {
+        if(pending[i] == 0)
+            scratch[tail++] = i;
+    }
+    while(head < tail)
+    {
+        size_t index = scratch[head++];
+        for(size_t k = pool->first[index]; k < pool->first[index + 1]; k++)
+        {
+            if(--pending[pool->dependents[k]] == 0)
+                scratch[tail++] = pool->dependents[k];
+        }
+    }
+    return tail == count;
+}
+
+static void aparse__pool_run(
+        void* userdata)
+{
+    aparse__worker_t *self = userdata;
+    aparse__pool_t *pool = self->pool;
+
+    for(;;)
+    {
+        size_t index = 0, seen = 0;
+        aparse__dispatch_t *entry = NULL;
+
+        aparse__mutex_lock(&pool->lock);
+        seen = pool->pushes;
+        if(pool->remaining == 0)
+        {
+            aparse__mutex_unlock(&pool->lock);
+            break;
+        }
+        aparse__mutex_unlock(&pool->lock);
+
+        if(!aparse__pool_take(self, &index))
+        {
+            // Sleep until an entry becomes ready, unless one already did
+            aparse__mutex_lock(&pool->lock);
+            while(pool->remaining > 0 && pool->pushes == seen)
+                aparse__cond_wait(&pool->wake, &pool->lock);
+            aparse__mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        entry = &pool->entries[index];
+        if(entry->args->handler)
+            entry->args->handler(entry->args, entry->payload);
+        if(pool->results)
+        {
+            pool->results[index].status = APARSE_STATUS_OK;
+            pool->results[index].worker = self->id;
+        }
+        aparse__pool_finish(self, index);
+    }
+}
+
+// The most recent entry of our own deque, else the oldest of another one
+static bool aparse__pool_take(
+        aparse__worker_t* self,
+        size_t* index)
+{
+    aparse__pool_t *pool = self->pool;
+    bool found = false;
+
+    aparse__mutex_lock(&self->lock);
+    if(self->bottom > self->top)
+    {
+        *index = self->items[--self->bottom];
+        found = true;
+    }
+    aparse__mutex_unlock(&self->lock);
+
+    for(unsigned i = 1; !found && i < pool->worker_count; i++)
     {
-        if(!(sa->type & APARSE_ARG_TYPE_ARRAY))
+        aparse__worker_t *victim = 
+            &pool->workers[(self->id + i) % pool->worker_count];
+        aparse__mutex_lock(&victim->lock);
+        if(victim->bottom > victim->top)
+        {
+            *index = victim->items[victim->top++];
+            found = true;
+        }
+        aparse__mutex_unlock(&victim->lock);
+    }
+    return found;
+}
+
+// Release the dependents of a finished entry into our own deque
+static void aparse__pool_finish(
+        aparse__worker_t* self,
+        const size_t index)
+{
+    aparse__pool_t *pool = self->pool;
+    bool wake = false;
+
+    aparse__mutex_lock(&pool->lock);
+    pool->remaining--;
+    for(size_t k = pool->first[index]; k < pool->first[index + 1]; k++)
+    {
+        size_t dependent = pool->dependents[k];
+        if(--pool->pending[dependent] != 0)
             continue;
-        free(((aparse_list*)sa->ptr)->ptr);
+        aparse__mutex_lock(&self->lock);
+        self->items[self->bottom++] = dependent;
+        aparse__mutex_unlock(&self->lock);
+        pool->pushes++;
+        wake = true;
     }
+    if(wake || pool->remaining == 0)
+        aparse__cond_broadcast(&pool->wake);
+    aparse__mutex_unlock(&pool->lock);
+}
+
+static void* aparse__count_alloc(
+        void* userdata,
+        size_t size)
+{
+    aparse__context_t *ctx = userdata;
+    aparse__probe_begin(start);
+    void *ptr = aparse_allocator_alloc(ctx->backing, size);
+    aparse__probe_end(ctx, APARSE__PHASE_ALLOC, start);
+    if(!ptr)
+        return NULL;
+    ctx->stats.count++;
+    ctx->stats.bytes += size;
+    ctx->live += size;
+    if(ctx->live > ctx->stats.peak)
+        ctx->stats.peak = ctx->live;
+    return ptr;
+}
+
+static void* aparse__count_realloc(
+        void* userdata,
+        void* ptr,
+        size_t old_size,
+        size_t new_size)
+{
+    aparse__context_t *ctx = userdata;
+    aparse__probe_begin(start);
+    void *tmp = aparse_allocator_realloc(ctx->backing, ptr, old_size, new_size);
+    aparse__probe_end(ctx, APARSE__PHASE_ALLOC, start);
+    if(!tmp)
+        return NULL;
+    ctx->stats.count++;
+    if(new_size > old_size)
+        ctx->stats.bytes += new_size - old_size;
+    ctx->live = ctx->live + new_size - old_size;
+    if(ctx->live > ctx->stats.peak)
+        ctx->stats.peak = ctx->live;
+    return tmp;
+}
+
+static void aparse__count_free(
+        void* userdata,
+        void* ptr,
+        size_t size)
+{
+    aparse__context_t *ctx = userdata;
+    if(!ptr)
+        return;
+    aparse__probe_begin(start);
+    aparse_allocator_free(ctx->backing, ptr, size);
+    aparse__probe_end(ctx, APARSE__PHASE_ALLOC, start);
+    ctx->live -= APARSE__MIN(size, ctx->live);
+}
+
+#ifdef APARSE_STATS
+static uint64_t aparse__clock_ns(void)
+{
+    struct timespec ts;
+    if(timespec_get(&ts, TIME_UTC) != TIME_UTC)
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void aparse__stats_finish(
+        aparse__context_t* ctx)
+{
+    const uint64_t ticks = aparse__ticks() - ctx->start_ticks;
+    const uint64_t now = aparse__clock_ns();
+    aparse_stats *stats = &ctx->parser->phase_stats;
+    double scale = 1.0;
+
+    stats->total_ns = now > ctx->start_ns ? now - ctx->start_ns : 0;
+#ifndef APARSE__TICKS_NS
+    scale = ticks ? (double)stats->total_ns / (double)ticks : 0.0;
+#else
+    (void)ticks;
+#endif
+    stats->match_ns    = (uint64_t)((double)ctx->phases[APARSE__PHASE_MATCH] * scale);
+    stats->convert_ns  = (uint64_t)((double)ctx->phases[APARSE__PHASE_CONVERT] * scale);
+    stats->layout_ns   = (uint64_t)((double)ctx->phases[APARSE__PHASE_LAYOUT] * scale);
+    stats->alloc_ns    = (uint64_t)((double)ctx->phases[APARSE__PHASE_ALLOC] * scale);
+    stats->missing_ns  = (uint64_t)((double)ctx->phases[APARSE__PHASE_MISSING] * scale);
+    stats->dispatch_ns = (uint64_t)((double)ctx->phases[APARSE__PHASE_DISPATCH] * scale);
+    stats->tokens = ctx->idx > 1 ? (size_t)(ctx->idx - 1) : 0;
+    stats->matches = ctx->matches;
+}
+#endif
+
+static void* aparse__fixed_alloc(void* userdata, size_t size)
+{
+    (void)userdata;
+    (void)size;
+    return NULL;
+}
+
+static void* aparse__fixed_realloc(
+        void* userdata, 
+        void* ptr, 
+        size_t old_size, 
+        size_t new_size)
+{
+    (void)userdata;
+    (void)ptr;
+    (void)old_size;
+    (void)new_size;
+    return NULL;
+}
+
+static void aparse__fixed_free(void* userdata, void* ptr, size_t size)
+{
+    (void)userdata;
+    (void)ptr;
+    (void)size;
+}
+
+// Inline storage that never grows, adding past capacity fails
+static const aparse_allocator aparse__fixed_allocator = {
+    .alloc = aparse__fixed_alloc,
+    .realloc = aparse__fixed_realloc,
+    .free = aparse__fixed_free
+};
+
+static void aparse__list_fixed(
+        aparse_list* list,
+        void* storage,
+        const size_t capacity)
+{
+    list->ptr = storage;
+    list->size = 0;
+    list->capacity = capacity;
+    list->allocator = &aparse__fixed_allocator;
 }
 
 // 0 no error, 1 error (just for cleaning up)
 static aparse_status aparse__check_missing(
-        aparse_context* ctx,
-        aparse_arg* args) 
+        aparse_context* ctx) 
 {
-    aparse_list missing_args = {.itemsz = sizeof(aparse_arg*)};
-    aparse__tillend(item, args)
+    const aparse_arg *inline_missing[APARSE__INLINE_LIST];
+    aparse_list missing_args = {
+        .itemsz = sizeof(const aparse_arg*),
+        .allocator = ctx->alloc
+    };
+    const aparse__level_t *level = &ctx->stack[ctx->stack_top - 1];
+    if(ctx->parser->no_alloc)
+        aparse__list_fixed(&missing_args, inline_missing, APARSE__INLINE_LIST);
+    // Compiled levels know their positionals, in declaration order
+    const size_t count = level->node ? level->node->positional_count : level->count;
+    for(size_t n = 0; n < count; n++)
     {
+        const size_t i = level->node ? level->node->positionals[n] : n;
+        const aparse_arg *item = &level->args[i];
         if(aparse__is_positional(item) &&
-                !(item->flags & APARSE__ARG_PROCESSED))
-            aparse_list_add(&missing_args, &item);
+                !(aparse__level_slot(level, i)->flags & APARSE__ARG_PROCESSED))
+        {
+            if(!aparse_list_add(&missing_args, &item))
+            {
+                aparse_list_free(&missing_args);
+                aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+            }
+        }
     }
     if(missing_args.size > 0)
     {
-        aparse__raise_fatal(ctx, APARSE_STATUS_MISSING_POSITIONAL, 
+        aparse__raise_nonfatal(ctx, APARSE_STATUS_MISSING_POSITIONAL, 
                 &missing_args, NULL);
         aparse_list_free(&missing_args);
+        return APARSE_STATUS_FAILURE;
     }
 
     return APARSE_STATUS_OK;
 }
 
+static void aparse__batch_task_run(
+        void* userdata)
+{
+    aparse__batch_task_t *task = userdata;
+    aparse_parser parser = {0};
+    aparse_arena arena;
+
+    aparse_arena_init(&arena, NULL, 0);
+    parser.schema = task->schema;
+    parser.allocator = aparse_arena_allocator(&arena);
+    parser.err_callback = aparse__batch_errcb;
+    parser.batch = true;
+    for(size_t i = 0; i < task->count; i++)
+    {
+        aparse_batch_result *result = &task->results[i];
+        aparse_list dispatch_list = {0};
+        aparse_status status = APARSE_STATUS_OK;
+
+        *result = (aparse_batch_result){ .status = APARSE_STATUS_OK, .token = -1 };
+        parser.err_userdata = result;
+        status = aparse__parse_root(&parser, task->argcs[i], task->argvs[i], 
+                &dispatch_list);
+        if(status == APARSE_STATUS_OK)
+            *result = (aparse_batch_result){ .status = APARSE_STATUS_OK, .token = -1 };
+        else {
+            if(result->status == APARSE_STATUS_OK)
+                result->status = status;
+            task->failed++;
+        }
+        aparse_dispatch_free(&dispatch_list);
+        aparse_arena_reset(&arena);
+    }
+    aparse_arena_destroy(&arena);
+}
+
+// Keeps the first error of the input, float underflows are only warnings
+static void aparse__batch_errcb(
+        const aparse_context* ctx,
+        const aparse_status status, 
+        const void* field1, 
+        const void* field2, 
+        void* userdata)
+{
+    aparse_batch_result *result = userdata;
+    (void)field2;
+    if(result->status != APARSE_STATUS_OK || 
+            (status == APARSE_STATUS_UNDERFLOW && 
+             aparse__type_cmp(field1, APARSE_ARG_TYPE_FLOAT)))
+        return;
+    result->status = status;
+    result->token = status == APARSE_STATUS_MISSING_POSITIONAL ? -1 : ctx->idx - 1;
+    if(status == APARSE_STATUS_UNKNOWN_ARGUMENT)
+    {
+        const aparse_list *unknown = field1;
+        const char *first = aparse_list_get(unknown, const char*, 0);
+        for(int i = 1; i < ctx->argc; i++)
+        {
+            if(ctx->argv[i] == first)
+            {
+                result->token = i;
+                break;
+            }
+        }
+    }
+}
+
 static void aparse__default_errcb(
         const aparse_context* ctx,
         const aparse_status status, 
@@ -982,7 +3353,7 @@ static void aparse__default_errcb(
         case APARSE_STATUS_UNKNOWN_ARGUMENT:
         {
             const aparse_list* args = field1;
-            fprintf(stderr, "%s: " __aparse_error_label ": unrecognized arguments: ", __aparse_progname);
+            fprintf(stderr, "%s: " __aparse_error_label ": unrecognized arguments: ", ctx->parser->progname);
             char** unknowns = args->ptr;
             for (size_t i = 0; i < args->size; i++, unknowns++) {
                 if (i > 0) fprintf(stderr, ", ");
@@ -995,8 +3366,10 @@ static void aparse__default_errcb(
         {
             const aparse_arg* arg = field1;
             const int expected_count = *(const int*)field2;
-            aparse_prog_error("option '%s' expected %d argument.",
-                arg->flags & APARSE__ARG_SHORT_MATCH ? arg->shortopt : arg->longopt,
+            const aparse__slot_t* slot = aparse__find_slot(ctx, arg);
+            fprintf(stderr, "%s: " __aparse_error_label ": option '%s' expected %d argument.\n",
+                ctx->parser->progname,
+                slot && (slot->flags & APARSE__ARG_SHORT_MATCH) ? arg->shortopt : arg->longopt,
                 expected_count);
             break;
         }
@@ -1004,7 +3377,8 @@ static void aparse__default_errcb(
         {
             const aparse_arg* arg = field1;
             const char* cargv = field2;
-            aparse_prog_error("invalid %s '%s'",
+            fprintf(stderr, "%s: " __aparse_error_label ": invalid %s '%s'\n",
+                ctx->parser->progname,
                 arg->type & APARSE_ARG_TYPE_FLOAT ? "float" : "integer", cargv);
             break;
         }
@@ -1032,11 +3406,11 @@ static void aparse__default_errcb(
         {
             const aparse_list* args = field1;
             aparse__print_usage(ctx);
-            fprintf(stderr, "%s: " __aparse_error_label ": the following arguments are required: ", __aparse_progname);
+            fprintf(stderr, "%s: " __aparse_error_label ": the following arguments are required: ", ctx->parser->progname);
             int printed = 0;
             for (size_t i = 0; i < args->size; i++) 
             {
-                aparse_arg *item = aparse_list_get(args, aparse_arg*, i);
+                const aparse_arg *item = aparse_list_get(args, const aparse_arg*, i);
                 if (printed++ > 0) 
                     fprintf(stderr, ", ");
                 fprintf(stderr, "%s", item->longopt);
@@ -1049,8 +3423,8 @@ static void aparse__default_errcb(
             const aparse_list* args = field1;
             const char* cargv = field2;
             aparse__print_usage(ctx);
-            fprintf(stderr, "%s: " __aparse_error_label ": invalid choice: '%s' (choose from ", __aparse_progname, cargv);
-            aparse_arg* a = args->ptr;
+            fprintf(stderr, "%s: " __aparse_error_label ": invalid choice: '%s' (choose from ", ctx->parser->progname, cargv);
+            const aparse_arg* a = args->ptr;
             for(size_t i = 0; i < args->size; i++, a++)
                 fprintf(stderr, "%s%s", a->longopt, i < (args->size - 1) ? ", " : "");
             fprintf(stderr, ")\n");
@@ -1106,6 +3480,14 @@ static void aparse__default_errcb(
             aparse__lib__error("parser nesting depth exceeded the limit");
             break;
         }
+        case APARSE_STATUS_RESPONSE_FILE:
+        {
+            const char* path = field1;
+            aparse__print_usage(ctx);
+            fprintf(stderr, "%s: " __aparse_error_label ": cannot read response file '%s'\n", 
+                    ctx->parser->progname, path);
+            break;
+        }
         default:
         {
             aparse__lib__error("unhandled error message");
@@ -1115,41 +3497,217 @@ static void aparse__default_errcb(
 }
 
 static void aparse__print_help(
-        aparse_arg* main_args,
         aparse__context_t *ctx) 
 {
-    aparse__print_usage(ctx);
-    printf("\n");
+    char chunk[APARSE__RENDER_CHUNK];
+    aparse__render_t r = {0};
+    aparse__render_init(&r, chunk, sizeof(chunk), ctx->alloc, 0);
+    aparse__render_help(&r, ctx);
+    aparse__render_flush(&r);
+    aparse__render_release(&r);
+}
+
+static void aparse__print_usage(
+        const aparse_context *ctx) 
+{
+    char chunk[APARSE__RENDER_CHUNK];
+    aparse__render_t r = {0};
+    aparse__render_init(&r, chunk, sizeof(chunk), ctx->alloc, 0);
+    aparse__render_usage(&r, ctx);
+    aparse__render_flush(&r);
+    aparse__render_release(&r);
+}
+
+static void aparse__render_init(
+        aparse__render_t* r,
+        char* buffer,
+        const size_t size,
+        const aparse_allocator* alloc,
+        const int width)
+{
+    *r = (aparse__render_t){
+        .ptr = buffer,
+        .capacity = size,
+        .chunk = buffer,
+        .alloc = alloc,
+        .growable = alloc != NULL,
+        .width = width > 0 ? width : aparse__get_term_width()
+    };
+}
+
+static void aparse__render_write(
+        aparse__render_t* r,
+        const char* data,
+        size_t len)
+{
+    r->length += len;
+    if(len > r->capacity - r->size && r->growable)
+    {
+        size_t capacity = r->capacity * 2;
+        char *tmp = NULL;
+        if(capacity < r->size + len)
+            capacity = r->size + len;
+        if(r->ptr == r->chunk)
+        {
+            tmp = aparse_allocator_alloc(r->alloc, capacity);
+            if(tmp)
+                memcpy(tmp, r->ptr, r->size);
+        } else
+            tmp = aparse_allocator_realloc(r->alloc, r->ptr, r->capacity, capacity);
+        if(tmp)
+        {
+            r->ptr = tmp;
+            r->capacity = capacity;
+        } else {
+            // Out of memory, the text goes out in pieces instead
+            aparse__render_flush(r);
+            if(len > r->capacity)
+            {
+                aparse__render_out(data, len);
+                return;
+            }
+        }
+    }
+    if(len > r->capacity - r->size)
+        len = r->capacity - r->size; // a caller buffer, truncated
+    if(len == 0)
+        return;
+    memcpy(r->ptr + r->size, data, len);
+    r->size += len;
+}
+
+static void aparse__render_str(
+        aparse__render_t* r,
+        const char* str)
+{
+    aparse__render_write(r, str, strlen(str));
+}
+
+static void aparse__render_pad(
+        aparse__render_t* r,
+        int count)
+{
+    static const char spaces[] = "                                ";
+    for(; count > 0; count -= (int)(sizeof(spaces) - 1))
+        aparse__render_write(r, spaces, 
+                APARSE__MIN((size_t)count, sizeof(spaces) - 1));
+}
+
+static void aparse__render_flush(
+        aparse__render_t* r)
+{
+    if(!r->growable)
+        return;
+    aparse__render_out(r->ptr, r->size);
+    r->size = 0;
+}
+
+static void aparse__render_release(
+        aparse__render_t* r)
+{
+    if(r->ptr != r->chunk)
+        aparse_allocator_free(r->alloc, r->ptr, r->capacity);
+    r->ptr = r->chunk = NULL;
+}
+
+// One write for the whole text, after whatever stdio still holds
+static void aparse__render_out(
+        const char* data,
+        size_t size)
+{
+    fflush(stdout);
+#ifdef _WIN32
+    fwrite(data, 1, size, stdout);
+    fflush(stdout);
+#else
+    while(size > 0)
+    {
+        ssize_t written = write(STDOUT_FILENO, data, size);
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+#endif
+}
+
+// Top level help or usage of a parser into a caller buffer
+static size_t aparse__format_text(
+        const aparse_parser* parser,
+        char* buffer,
+        const size_t size,
+        const int width,
+        const bool help)
+{
+    aparse__context_t ctx = {0};
+    aparse__render_t r = {0};
+    const aparse__node_t *root = NULL;
+
+    if(size > 0)
+        buffer[0] = '\0';
+    if(!parser)
+        return 0;
+    root = parser->schema ? parser->schema->root : NULL;
+    ctx.parser = (aparse_parser*)(uintptr_t)parser;
+    ctx.stack[0].args = root ? root->args : parser->args;
+    ctx.stack_top = 1;
+    if(!ctx.stack[0].args)
+        return 0;
+
+    aparse__render_init(&r, buffer, size ? size - 1 : 0, NULL, width);
+    if(help)
+        aparse__render_help(&r, &ctx);
+    else
+        aparse__render_usage(&r, &ctx);
+    if(size > 0)
+        buffer[r.size] = '\0';
+    return r.length;
+}
+
+static void aparse__render_help(
+        aparse__render_t* r,
+        const aparse_context *ctx) 
+{
+    const aparse_arg *main_args = ctx->stack[ctx->stack_top - 1].args;
+    aparse__render_usage(r, ctx);
+    aparse__render_str(r, "\n");
     if(ctx->stack_top == 1) 
     {
-        if(aparse__desc)
-            printf("%s\n\n", aparse__desc);
+        if(ctx->parser->desc)
+        {
+            aparse__render_str(r, ctx->parser->desc);
+            aparse__render_str(r, "\n\n");
+        }
     }
-    printf("positional arguments:\n");
-    aparse__print_pos_help(main_args);
-    printf("\noptions:\n");
-    aparse__print_help_tag(&aparse__help_arg, APARSE__SPACE_PER_INDENT);
+    aparse__render_str(r, "positional arguments:\n");
+    aparse__render_pos_help(r, main_args);
+    aparse__render_str(r, "\noptions:\n");
+    aparse__render_help_tag(r, &aparse__help_arg, APARSE__SPACE_PER_INDENT);
 
-    for(aparse_arg *sa = main_args;
+    for(const aparse_arg *sa = main_args;
             aparse_arg_nend(sa); sa++)
     {
         if (
                 aparse__is_argument(sa) && 
                 !aparse__is_positional(sa))
-            aparse__print_help_tag(sa, APARSE__SPACE_PER_INDENT);
+            aparse__render_help_tag(r, sa, APARSE__SPACE_PER_INDENT);
     }
 }
 
-static void aparse__print_wrapped(
+static void aparse__render_wrapped(
+        aparse__render_t* r,
         const char *text,
-        const int start_col,
-        const int term_width)
+        const int start_col)
 {
-    int usable_width = term_width - start_col;
+    int usable_width = r->width - start_col;
     int col = 0;
     const char *p = text;
 
-    printf("%*s", start_col, "");
+    aparse__render_pad(r, start_col);
     while (*p)
     {
         const char *word_start = NULL;
@@ -1157,8 +3715,8 @@ static void aparse__print_wrapped(
 
         if (*p == '\n')
         {
-            putchar('\n');
-            printf("%*s", start_col, "");
+            aparse__render_str(r, "\n");
+            aparse__render_pad(r, start_col);
             col = 0;
             p++;
             continue;
@@ -1182,55 +3740,48 @@ static void aparse__print_wrapped(
 
         if (col && (col + extra + word_len > usable_width))
         {
-            putchar('\n');
-            printf("%*s", start_col, "");
+            aparse__render_str(r, "\n");
+            aparse__render_pad(r, start_col);
             col = 0;
             extra = 0;
         }
 
         if (extra)
         {
-            putchar(' ');
+            aparse__render_str(r, " ");
             col += 1;
         }
 
-        fwrite(word_start, 1, (size_t)word_len, stdout);
+        aparse__render_write(r, word_start, (size_t)word_len);
         col += word_len;
     }
 }
-static void aparse__print_help_tag(
+
+static void aparse__render_help_tag(
+        aparse__render_t* r,
         const aparse_arg* arg,
         const int indent)
 {
-    int len = 0;
+    const size_t start = r->length;
     if (!aparse__is_argument(arg) && !arg->help && !aparse_arg_nend(arg))
         return;
 
-
-    len += printf("%*s", indent, "");
+    aparse__render_pad(r, indent);
     if (arg->shortopt)
-        len += printf("%s", arg->shortopt);
+        aparse__render_str(r, arg->shortopt);
     if (arg->shortopt && arg->longopt)
-        len += printf(", ");
+        aparse__render_str(r, ", ");
     if (arg->longopt)
-        len += printf("%s", arg->longopt);
+        aparse__render_str(r, arg->longopt);
 
     if (!aparse__is_positional(arg) &&
         arg->type != APARSE_ARG_TYPE_BOOL)
     {
-        const char* option = arg->longopt ? arg->longopt : arg->shortopt;
-        size_t idx = aparse__option_value_index(option);
-
-        putchar(' ');
-        len += 1;
-
-        for (const char* ch = option + idx; *ch != '\0'; ch++)
-        {
-            putchar(toupper((unsigned char)*ch));
-            len += 1;
-        }
+        aparse__render_str(r, " ");
+        aparse__render_metavar(r, arg);
     }
 
+    const int len = (int)(r->length - start);
     bool longer = len > MAX_ARG_STR;
 
     if (arg->help)
@@ -1239,62 +3790,88 @@ static void aparse__print_help_tag(
             (longer ? APARSE__SPACE_PER_INDENT + MAX_ARG_STR : MAX_ARG_STR - len);
 
         if (longer)
-            printf("\n");
+            aparse__render_str(r, "\n");
 
-        aparse__print_wrapped(arg->help, space, aparse__get_term_width());
+        aparse__render_wrapped(r, arg->help, space);
     }
 
-    printf("\n");
+    aparse__render_str(r, "\n");
+}
+
+// The option name without its dashes, in upper case
+static void aparse__render_metavar(
+        aparse__render_t* r,
+        const aparse_arg* arg)
+{
+    const char* option = arg->longopt ? arg->longopt : arg->shortopt;
+    char upper[32];
+    size_t len = 0;
+
+    for (const char* ch = option + aparse__option_value_index(option); 
+            *ch != '\0'; ch++)
+    {
+        upper[len++] = (char)toupper((unsigned char)*ch);
+        if (len == sizeof(upper))
+        {
+            aparse__render_write(r, upper, len);
+            len = 0;
+        }
+    }
+    aparse__render_write(r, upper, len);
 }
 
-static void aparse__print_pos_help(aparse_arg* args) 
+static void aparse__render_pos_help(
+        aparse__render_t* r,
+        const aparse_arg* args) 
 {
     for (; aparse_arg_nend(args); args++) {
         if (aparse__is_positional(args)) {
             if(aparse__is_argument(args)) {
-                aparse__print_help_tag(args, APARSE__SPACE_PER_INDENT);
+                aparse__render_help_tag(r, args, APARSE__SPACE_PER_INDENT);
                 continue;
             }
-            printf("%*s", APARSE__SPACE_PER_INDENT, "");
-            aparse__print_subcmds(args);
-            printf("\n");
+            aparse__render_pad(r, APARSE__SPACE_PER_INDENT);
+            aparse__render_subcmds(r, args);
+            aparse__render_str(r, "\n");
 
             aparse__foreach(ptr, args)
             {
-                aparse__print_help_tag(ptr, 
+                aparse__render_help_tag(r, ptr, 
                         APARSE__SPACE_PER_INDENT * 2);
             }
         }
     }
 }
 
-static void aparse__print_subcmds(
+static void aparse__render_subcmds(
+        aparse__render_t* r,
         const aparse_arg* args) 
 {
     int index = 0;
     if (!args || !args->subargs)
     {
-        printf("{}");
+        aparse__render_str(r, "{}");
         return;
     }
 
-    printf("{");
+    aparse__render_str(r, "{");
     aparse__foreach(ptr, args)
     {
         const char* name = ptr->longopt ? ptr->longopt : "";
         if (index++ > 0)
-            printf(", ");
-        printf("%s", name);
+            aparse__render_str(r, ", ");
+        aparse__render_str(r, name);
     }
 
-    printf("}");
+    aparse__render_str(r, "}");
 }
 
-static void aparse__print_usage_before(
+static void aparse__render_usage_before(
+        aparse__render_t* r,
         const aparse_context *ctx) 
 {
     int idx = 0;
-    aparse_arg *arg = NULL;
+    const aparse_arg *arg = NULL;
 
     for(;;)
     {
@@ -1302,23 +3879,27 @@ static void aparse__print_usage_before(
         if(idx >= ctx->stack_top - 1)
             break;
 
-        arg = ctx->stack[idx];
+        arg = ctx->stack[idx].args;
         for(; aparse_arg_nend(arg); arg++)
         {
             if(!aparse__is_positional(arg))
                 continue;
 
             if(aparse__is_argument(arg))
-                printf("%s ", arg->longopt);
+            {
+                aparse__render_str(r, arg->longopt);
+                aparse__render_str(r, " ");
+            }
             else
             {
                 aparse__foreach(subcmd, arg)
                 {
-                    if(subcmd->subargs == ctx->stack[idx + 1])
+                    if(subcmd->subargs == ctx->stack[idx + 1].args)
                     {
                         idx++;
                         found = true;
-                        printf("%s ", subcmd->longopt);
+                        aparse__render_str(r, subcmd->longopt);
+                        aparse__render_str(r, " ");
                         break;
                     }
                 }
@@ -1335,118 +3916,493 @@ static void aparse__print_usage_before(
     }
 }
 
-static void aparse_print_usage_after(aparse_arg* args)
+// Options first, then the positionals in order
+static void aparse__render_usage_after(
+        aparse__render_t* r,
+        const aparse_arg* args)
 {
-    aparse_list list = {.itemsz = sizeof(aparse_arg*)};
-    for(aparse_arg *sa = args;
+    for(const aparse_arg *sa = args;
             aparse_arg_nend(sa); sa++)
     {
         if(aparse__is_positional(sa))
-            aparse_list_add(&list, &sa);
-        else {
-            printf("[%s", sa->shortopt ? sa->shortopt : sa->longopt);
-            if(!aparse__type_cmp(sa, APARSE_ARG_TYPE_BOOL))
-            {
-                const char *option = 0;
-                size_t idx = 0;
-                
-                option = sa->longopt ? sa->longopt : sa->shortopt;
-                idx = aparse__option_value_index(option);
-                putchar(' ');
-                for(const char *ch = option + idx; *ch != '\0'; ch++)
-                    putchar(toupper(*ch));
-            }
-            printf("] ");
+            continue;
+        aparse__render_str(r, "[");
+        aparse__render_str(r, sa->shortopt ? sa->shortopt : sa->longopt);
+        if(!aparse__type_cmp(sa, APARSE_ARG_TYPE_BOOL))
+        {
+            aparse__render_str(r, " ");
+            aparse__render_metavar(r, sa);
         }
+        aparse__render_str(r, "] ");
     }
-    for(size_t i = 0; i < list.size; i++)
+    for(const aparse_arg *sa = args;
+            aparse_arg_nend(sa); sa++)
     {
-        aparse_arg* entry = aparse_list_get(&list, aparse_arg*, i);
-        if(aparse__is_argument(entry))
-            printf("%s ", entry->longopt);
+        if(!aparse__is_positional(sa))
+            continue;
+        if(aparse__is_argument(sa))
+        {
+            aparse__render_str(r, sa->longopt);
+            aparse__render_str(r, " ");
+        }
         else {
-            aparse__print_subcmds(entry);
-            printf(" ... ");
+            aparse__render_subcmds(r, sa);
+            aparse__render_str(r, " ... ");
         }
     }
-    aparse_list_free(&list);
-    printf("\n");
+    aparse__render_str(r, "\n");
 }
 
-static void aparse__print_usage(
+static void aparse__render_usage(
+        aparse__render_t* r,
         const aparse_context *ctx) 
 {
-    printf("usage: %s ", __aparse_progname);
-    aparse__print_usage_before(ctx);
-    aparse_print_usage_after(ctx->stack[ctx->stack_top - 1]);
+    aparse__render_str(r, "usage: ");
+    aparse__render_str(r, ctx->parser->progname ? ctx->parser->progname : "");
+    aparse__render_str(r, " ");
+    aparse__render_usage_before(r, ctx);
+    aparse__render_usage_after(r, ctx->stack[ctx->stack_top - 1].args);
 }
 
-static void aparse__reset_state(
-        aparse_arg *args)
+static aparse__node_t* aparse__compile_node(
+        aparse_schema* schema,
+        const aparse_arg* args,
+        const int depth,
+        const bool is_choices)
 {
-    if(!args)
-        return;
+    aparse__node_t *node = NULL;
+    aparse__node_t **children = NULL;
+    uint32_t *positionals = NULL, *envs = NULL;
+    size_t count = 0, positional_count = 0, env_count = 0, block_size = 0;
+    uint8_t *block = NULL;
+
     aparse__tillend(arg, args)
+        count++;
+
+    block_size = aparse__node_block_size(count);
+    block = aparse_allocator_alloc(NULL, block_size);
+    if(!block)
+        return NULL;
+    memset(block, 0, block_size);
+    if(!aparse_list_add(&schema->nodes, &block))
+    {
+        aparse_allocator_free(NULL, block, block_size);
+        return NULL;
+    }
+
+    node = (aparse__node_t*)block;
+    children = (aparse__node_t**)(block + sizeof(aparse__node_t));
+    positionals = (uint32_t*)(children + count);
+    envs = positionals + count;
+    node->args = args;
+    node->count = count;
+    node->children = (const aparse__node_t* const*)children;
+    node->positionals = positionals;
+    node->envs = envs;
+
+    for(size_t i = 0; i < count; i++)
+    {
+        const aparse_arg *arg = &args[i];
+        if(arg->env && aparse__is_argument(arg))
+            envs[env_count++] = (uint32_t)i;
+        if(!aparse__is_positional(arg))
+            continue;
+        positionals[positional_count++] = (uint32_t)i;
+
+        // Levels deeper than the parser can reach are left to the
+        // linear fallback, this also stops self-referencing tables
+        if(aparse__is_argument(arg) || !arg->subargs || 
+                depth + 1 >= APARSE__MAX_DEPTH * 2)
+            continue;
+        children[i] = aparse__compile_node(schema, 
+                arg->subargs, depth + 1, !is_choices);
+        if(!children[i])
+            return NULL;
+    }
+    node->positional_count = positional_count;
+    node->env_count = env_count;
+
+    if(!aparse__build_index(node, is_choices))
+        return NULL;
+    return node;
+}
+
+APARSE_INLINE uint32_t aparse__hash_name(
+        const char* name,
+        size_t* len)
+{
+    uint32_t hash = 2166136261u;
+    size_t i = 0;
+    for(; name[i] && name[i] != '='; i++)
+    {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    *len = i;
+    return hash;
+}
+
+// Keep in sync with script/schema_gen.py
+APARSE_INLINE uint32_t aparse__hash_mix(
+        uint32_t hash)
+{
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+// is_choices: the node is a list of subcommands, not a parser level
+static bool aparse__build_index(
+        aparse__node_t* node,
+        const bool is_choices)
+{
+    size_t name_count = 0, capacity = 4;
+    uint32_t *index = NULL;
+    for(size_t i = 0; i < node->count; i++)
+    {
+        const aparse_arg *arg = &node->args[i];
+        if(is_choices)
+        {
+            name_count += arg->longopt ? 1 : 0;
+            continue;
+        }
+        if(aparse__is_positional(arg))
+            continue;
+        if(arg->shortopt)
+            name_count++;
+        if(arg->longopt)
+            name_count++;
+    }
+    if(name_count == 0)
+        return true;
+
+    while(capacity < name_count * 2)
+        capacity <<= 1;
+    index = aparse_allocator_alloc(NULL, capacity * sizeof(uint32_t));
+    if(!index)
+        return false;
+    memset(index, 0, capacity * sizeof(uint32_t));
+    node->index = index;
+    node->index_size = (uint32_t)capacity;
+
+    for(size_t i = 0; i < node->count; i++)
     {
-        if(
-                aparse__is_positional(arg) && 
-                !aparse__is_argument(arg))
+        const aparse_arg *arg = &node->args[i];
+        if(!is_choices && aparse__is_positional(arg))
+            continue;
+
+        for(int is_short = is_choices ? 0 : 1; is_short >= 0; is_short--)
         {
-            aparse__foreach(subcmd, arg)
-                aparse__reset_state(subcmd->subargs);
+            const char *name = is_short ? arg->shortopt : arg->longopt;
+            bool has_equal = false, dup_short = false;
+            size_t len = 0;
+            uint32_t bucket = 0;
+            if(!name)
+                continue;
+
+            // Earlier definitions win, like the linear matching does
+            if(aparse__index_match(node, name, &dup_short, &has_equal))
+                continue;
+
+            bucket = aparse__hash_name(name, &len) & (node->index_size - 1);
+            while(index[bucket])
+                bucket = (bucket + 1) & (node->index_size - 1);
+            index[bucket] = (uint32_t)((i << 1) | (size_t)is_short) + 1;
         }
+    }
+    return true;
+}
 
-        arg->flags = 0;
+static const aparse_arg* aparse__index_match(
+        const aparse__node_t* node,
+        const char* argv,
+        bool* is_short,
+        bool* has_equal)
+{
+    size_t len = 0;
+    uint32_t hash = 0, bucket = 0, mask = 0;
+    if(!node->index)
+        return NULL;
+
+    hash = aparse__hash_name(argv, &len);
+
+    // Generated tables use a minimal perfect hash, every bucket is filled
+    // and only the single candidate has to be compared
+    if(node->displace)
+    {
+        uint32_t displace = node->displace[hash % node->displace_size];
+        bucket = aparse__hash_mix(hash ^ displace) % node->index_size;
+        mask = 0;
+    } else {
+        mask = node->index_size - 1;
+        bucket = hash & mask;
+    }
+
+    for(; node->index[bucket]; bucket = (bucket + 1) & mask)
+    {
+        uint32_t entry = node->index[bucket] - 1;
+        const aparse_arg *arg = &node->args[entry >> 1];
+        const char *name = (entry & 1) ? arg->shortopt : arg->longopt;
+
+        if(strncmp(name, argv, len) == 0 && name[len] == '\0')
+        {
+            *is_short = entry & 1;
+            *has_equal = argv[len] == '=';
+            return arg;
+        }
+        if(node->displace)
+            break;
     }
+    return NULL;
 }
 
-static aparse_arg* aparse__argv_match(
+static const aparse_arg* aparse__argv_match(
         const char* argv, 
-        aparse_arg* args)
+        aparse__context_t* ctx)
 {
-    aparse_arg* positional = NULL;
+    aparse__level_t *level = &ctx->stack[ctx->stack_top - 1];
+    const aparse__node_t *node = level->node;
+    const aparse_arg* positional = NULL;
     if(
             !strcmp(argv, aparse__help_arg.shortopt) || 
             !strcmp(argv, aparse__help_arg.longopt))
-        return (aparse_arg*)(uintptr_t)&aparse__help_arg;
+        return &aparse__help_arg;
+
+    bool is_short = false, has_equal = false;
+    const aparse_arg *match = aparse__option_match(level, argv, 
+            &is_short, &has_equal);
+    if(match)
+    {
+        aparse__mark_match(aparse__level_slot(level, (size_t)(match - level->args)), 
+                is_short, has_equal);
+        return match;
+    }
+
+    if(node)
+    {
+        for(size_t i = 0; i < node->positional_count; i++)
+        {
+            uint32_t pos = node->positionals[i];
+            if(!(aparse__level_slot(level, pos)->flags & APARSE__ARG_PROCESSED))
+                return &level->args[pos];
+        }
+        return NULL;
+    }
     
-    for(aparse_arg *sa = args;
-            aparse_arg_nend(sa); sa++)
+    for(size_t i = 0; i < level->count; i++)
     {
-        if (aparse__is_positional(sa)) {
-            if (!(sa->flags & APARSE__ARG_PROCESSED))
-                if(!positional)
-                    positional = sa;
-            continue;
+        const aparse_arg *sa = &level->args[i];
+        if (aparse__is_positional(sa) && 
+                !(aparse__level_slot(level, i)->flags & APARSE__ARG_PROCESSED))
+        {
+            positional = sa;
+            break;
         }
+    }
+    return positional;
+}
+
+// The optional argument of the level named by argv, without marking it
+static const aparse_arg* aparse__option_match(
+        const aparse__level_t* level,
+        const char* argv,
+        bool* is_short,
+        bool* has_equal)
+{
+    if(level->node)
+        return aparse__index_match(level->node, argv, is_short, has_equal);
+
+    for(size_t i = 0; i < level->count; i++)
+    {
+        const aparse_arg *sa = &level->args[i];
+        if (aparse__is_positional(sa))
+            continue;
         if (sa->shortopt) 
         {
             size_t shortlen = strlen(sa->shortopt);
-            if (strncmp(argv, sa->shortopt, shortlen) == 0) {
-                sa->flags |= APARSE__ARG_SHORT_MATCH;
-                if (argv[shortlen] == '\0') {
-                    return sa;
-                } else if (argv[shortlen] == '=') {
-                    sa->flags |= APARSE__ARG_EQUAL_VAL;
-                    return sa;
-                }
+            if (strncmp(argv, sa->shortopt, shortlen) == 0 &&
+                    (argv[shortlen] == '\0' || argv[shortlen] == '=')) 
+            {
+                *is_short = true;
+                *has_equal = argv[shortlen] == '=';
+                return sa;
             }
         }
         if (sa->longopt) 
         {
             size_t longlen = strlen(sa->longopt);
-            if (strncmp(argv, sa->longopt, longlen) == 0) {
-                sa->flags &= (uint8_t)~APARSE__ARG_SHORT_MATCH;
-                if (argv[longlen] == '\0') {
-                    return sa;
-                } else if (argv[longlen] == '=') {
-                    sa->flags |= APARSE__ARG_EQUAL_VAL;
-                    return sa;
-                }
+            if (strncmp(argv, sa->longopt, longlen) == 0 &&
+                    (argv[longlen] == '\0' || argv[longlen] == '=')) 
+            {
+                *is_short = false;
+                *has_equal = argv[longlen] == '=';
+                return sa;
             }
         }
     }
-    return positional;
+    return NULL;
+}
+
+// Whether argv names an option of any active level, or the help option
+static bool aparse__is_option(
+        const char* argv,
+        const aparse__context_t* ctx)
+{
+    bool is_short = false, has_equal = false;
+    if(
+            !strcmp(argv, aparse__help_arg.shortopt) || 
+            !strcmp(argv, aparse__help_arg.longopt))
+        return true;
+    for(int i = ctx->stack_top - 1; i >= 0; i--)
+    {
+        if(aparse__option_match(&ctx->stack[i], argv, &is_short, &has_equal))
+            return true;
+    }
+    return false;
+}
+
+static aparse__slot_t* aparse__find_slot(
+        const aparse_context* ctx,
+        const aparse_arg* arg)
+{
+    for(int i = ctx->stack_top - 1; i >= 0; i--)
+    {
+        const aparse__level_t *level = &ctx->stack[i];
+        if(arg >= level->args && arg < level->args + level->count)
+            return aparse__level_slot(level, (size_t)(arg - level->args));
+    }
+    return NULL;
+}
+
+static void aparse__mark_match(
+        aparse__slot_t* slot,
+        const bool is_short,
+        const bool has_equal)
+{
+    slot->flags &= (uint8_t)~(APARSE__ARG_SHORT_MATCH | APARSE__ARG_EQUAL_VAL);
+    slot->flags |= APARSE__ARG_GIVEN;
+    if(is_short)
+        slot->flags |= APARSE__ARG_SHORT_MATCH;
+    if(has_equal)
+        slot->flags |= APARSE__ARG_EQUAL_VAL;
+}
+
+// The env arguments of the level that argv left out, compiled levels
+// only visit those that have a variable name
+static aparse_status aparse__apply_env(
+        aparse__context_t* ctx)
+{
+    const aparse__level_t *level = &ctx->stack[ctx->stack_top - 1];
+    const aparse__node_t *node = level->node;
+    const size_t count = node ? node->env_count : level->count;
+
+    for(size_t n = 0; n < count; n++)
+    {
+        const size_t i = node ? node->envs[n] : n;
+        const aparse_arg *arg = &level->args[i];
+        aparse__slot_t *slot = NULL;
+        const char *value = NULL;
+        if(!arg->env || !aparse__is_argument(arg) || 
+                (arg->type & APARSE_ARG_TYPE_ARRAY))
+            continue;
+        slot = aparse__level_slot(level, i);
+        if(slot->flags & (APARSE__ARG_GIVEN | APARSE__ARG_PROCESSED))
+            continue;
+
+        if(!ctx->env_scanned && !aparse__index_env(ctx))
+            aparse__raise_fatal(ctx, APARSE_STATUS_ALLOC_FAILURE, 0, 0);
+        value = aparse__env_value(ctx, arg->env);
+        if(!value)
+            continue;
+        slot->flags |= APARSE__ARG_PROCESSED;
+
+        if(aparse__type_cmp(arg, APARSE_ARG_TYPE_BOOL))
+        {
+            if(!slot->ptr || slot->size == 0)
+                continue;
+            memset(slot->ptr, 0, slot->size);
+            if(value[0] != '\0' && strcmp(value, "0") != 0)
+                *((uint8_t*)slot->ptr + (APARSE_IS_LE ? 0 : slot->size - 1)) = 1;
+            continue;
+        }
+        if(aparse__process_argument(value, arg, 
+                    slot->ptr, slot->size, ctx) != APARSE_STATUS_OK)
+            return APARSE_STATUS_FAILURE;
+    }
+    return APARSE_STATUS_OK;
+}
+
+// One pass over environ, the first definition of a name wins like getenv.
+// No-alloc parsers scan environ on every lookup instead, an index sized to
+// the environment would not fit a small region
+static bool aparse__index_env(
+        aparse__context_t* ctx)
+{
+    char **env = aparse__environ;
+    size_t count = 0, capacity = 4;
+
+    ctx->env_scanned = true;
+    if(ctx->parser->no_alloc)
+        return true;
+    for(size_t i = 0; env && env[i]; i++)
+        count++;
+    if(count == 0)
+        return true;
+    while(capacity < count * 2)
+        capacity <<= 1;
+    ctx->env_index = aparse_allocator_alloc(ctx->alloc, 
+            capacity * sizeof(char*));
+    if(!ctx->env_index)
+        return false;
+    memset(ctx->env_index, 0, capacity * sizeof(char*));
+    ctx->env_size = capacity;
+
+    for(size_t i = 0; i < count; i++)
+    {
+        size_t len = 0;
+        uint32_t bucket = aparse__hash_name(env[i], &len) & (uint32_t)(capacity - 1);
+        for(; ctx->env_index[bucket]; bucket = (bucket + 1) & (uint32_t)(capacity - 1))
+        {
+            // Includes the '=', so only the same name compares equal
+            if(strncmp(ctx->env_index[bucket], env[i], len + 1) == 0)
+                break;
+        }
+        if(!ctx->env_index[bucket])
+            ctx->env_index[bucket] = env[i];
+    }
+    return true;
+}
+
+static const char* aparse__env_value(
+        const aparse__context_t* ctx,
+        const char* name)
+{
+    size_t len = 0;
+    uint32_t bucket = 0, mask = 0;
+    if(!ctx->env_index)
+    {
+        char **env = aparse__environ;
+        len = strlen(name);
+        for(size_t i = 0; env && env[i]; i++)
+        {
+            if(strncmp(env[i], name, len) == 0 && env[i][len] == '=')
+                return env[i] + len + 1;
+        }
+        return NULL;
+    }
+
+    mask = (uint32_t)(ctx->env_size - 1);
+    bucket = aparse__hash_name(name, &len) & mask;
+    for(; ctx->env_index[bucket]; bucket = (bucket + 1) & mask)
+    {
+        const char *entry = ctx->env_index[bucket];
+        if(strncmp(entry, name, len) == 0 && entry[len] == '=')
+            return entry + len + 1;
+    }
+    return NULL;
 }
 
 static const char* aparse__get_exename(
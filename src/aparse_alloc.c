@@ -0,0 +1,268 @@
+/*
+MIT License
+
+Copyright (c) 2025 binaryfox0
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "aparse_alloc.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define APARSE__ARENA_ALIGN _Alignof(max_align_t)
+#define APARSE__ARENA_BLOCK_SIZE 4096
+
+#define aparse__align_up(x) \
+    (((x) + APARSE__ARENA_ALIGN - 1) & ~(size_t)(APARSE__ARENA_ALIGN - 1))
+
+static const aparse_allocator *aparse__default_allocator = NULL;
+
+struct aparse__arena_block
+{
+    aparse__arena_block *next;
+    size_t size;
+    _Alignas(max_align_t) uint8_t data[];
+};
+
+static void* aparse__arena_alloc_cb(
+        void* userdata,
+        size_t size);
+
+static void* aparse__arena_realloc_cb(
+        void* userdata,
+        void* ptr,
+        size_t old_size,
+        size_t new_size);
+
+static void aparse__arena_free_cb(
+        void* userdata,
+        void* ptr,
+        size_t size);
+
+static bool aparse__arena_next_block(
+        aparse_arena* arena,
+        const size_t size);
+
+void aparse_arena_init(
+        aparse_arena* arena,
+        void* buffer,
+        const size_t size)
+{
+    if(!arena)
+        return;
+    memset(arena, 0, sizeof(*arena));
+    arena->allocator = (aparse_allocator){
+        .alloc = aparse__arena_alloc_cb,
+        .realloc = aparse__arena_realloc_cb,
+        .free = aparse__arena_free_cb,
+        .userdata = arena
+    };
+
+    if(buffer)
+    {
+        // Keep the bump offsets aligned relative to an aligned base
+        size_t skew = (size_t)((uintptr_t)buffer % APARSE__ARENA_ALIGN);
+        if(skew)
+            skew = APARSE__ARENA_ALIGN - skew;
+        if(skew > size)
+            skew = size;
+        arena->base = (uint8_t*)buffer + skew;
+        arena->size = size - skew;
+    } else {
+        arena->block_size = size ? size : APARSE__ARENA_BLOCK_SIZE;
+    }
+}
+
+void* aparse_arena_alloc(
+        aparse_arena* arena,
+        const size_t size)
+{
+    size_t offset = 0;
+    if(!arena || size == 0)
+        return NULL;
+
+    offset = aparse__align_up(arena->used);
+    if(offset > arena->size || size > arena->size - offset)
+    {
+        if(!arena->block_size || !aparse__arena_next_block(arena, size))
+            return NULL;
+        offset = 0;
+    }
+
+    arena->last = offset;
+    arena->used = offset + size;
+    return arena->base + offset;
+}
+
+void aparse_arena_reset(aparse_arena* arena)
+{
+    if(!arena)
+        return;
+    if(arena->head)
+    {
+        arena->current = arena->head;
+        arena->base = arena->head->data;
+        arena->size = arena->head->size;
+    }
+    arena->used = 0;
+    arena->last = 0;
+}
+
+void aparse_arena_destroy(aparse_arena* arena)
+{
+    aparse__arena_block *block = 0;
+    if(!arena)
+        return;
+    block = arena->head;
+    while(block)
+    {
+        aparse__arena_block *next = block->next;
+        aparse_allocator_free(NULL, block, 
+                sizeof(aparse__arena_block) + block->size);
+        block = next;
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+const aparse_allocator* aparse_arena_allocator(aparse_arena* arena)
+{
+    return arena ? &arena->allocator : NULL;
+}
+
+void aparse_set_allocator(const aparse_allocator* allocator)
+{
+    aparse__default_allocator = allocator;
+}
+
+void* aparse_allocator_alloc(
+        const aparse_allocator* allocator,
+        const size_t size)
+{
+    if(!allocator)
+        allocator = aparse__default_allocator;
+    if(!allocator)
+        return malloc(size);
+    return allocator->alloc(allocator->userdata, size);
+}
+
+void* aparse_allocator_realloc(
+        const aparse_allocator* allocator,
+        void* ptr,
+        const size_t old_size,
+        const size_t new_size)
+{
+    if(!allocator)
+        allocator = aparse__default_allocator;
+    if(!allocator)
+        return realloc(ptr, new_size);
+    return allocator->realloc(allocator->userdata, ptr, old_size, new_size);
+}
+
+void aparse_allocator_free(
+        const aparse_allocator* allocator,
+        void* ptr,
+        const size_t size)
+{
+    if(!allocator)
+        allocator = aparse__default_allocator;
+    if(!allocator)
+    {
+        free(ptr);
+        return;
+    }
+    allocator->free(allocator->userdata, ptr, size);
+}
+
+// --------------------------------------- PRIVATE ---------------------------------------
+static void* aparse__arena_alloc_cb(
+        void* userdata,
+        size_t size)
+{
+    return aparse_arena_alloc(userdata, size);
+}
+
+static void* aparse__arena_realloc_cb(
+        void* userdata,
+        void* ptr,
+        size_t old_size,
+        size_t new_size)
+{
+    aparse_arena *arena = userdata;
+    void *tmp = 0;
+    if(!ptr)
+        return aparse_arena_alloc(arena, new_size);
+
+    // The most recent allocation can grow in place
+    if((uint8_t*)ptr == arena->base + arena->last &&
+            new_size <= arena->size - arena->last)
+    {
+        arena->used = arena->last + new_size;
+        return ptr;
+    }
+    if(new_size <= old_size)
+        return ptr;
+
+    tmp = aparse_arena_alloc(arena, new_size);
+    if(!tmp)
+        return NULL;
+    memcpy(tmp, ptr, old_size);
+    return tmp;
+}
+
+static void aparse__arena_free_cb(
+        void* userdata,
+        void* ptr,
+        size_t size)
+{
+    aparse_arena *arena = userdata;
+    (void)size;
+    if(ptr && (uint8_t*)ptr == arena->base + arena->last)
+        arena->used = arena->last;
+}
+
+static bool aparse__arena_next_block(
+        aparse_arena* arena,
+        const size_t size)
+{
+    aparse__arena_block *block = arena->current ? arena->current->next : NULL;
+    if(!block || block->size < size)
+    {
+        size_t block_size = size > arena->block_size ? size : arena->block_size;
+        aparse__arena_block *new_block = aparse_allocator_alloc(NULL,
+                sizeof(aparse__arena_block) + block_size);
+        if(!new_block)
+            return false;
+        new_block->size = block_size;
+        new_block->next = block;
+        if(arena->current)
+            arena->current->next = new_block;
+        else
+            arena->head = new_block;
+        block = new_block;
+    }
+
+    arena->current = block;
+    arena->base = block->data;
+    arena->size = block->size;
+    arena->used = 0;
+    return true;
+}
@@ -23,6 +23,7 @@ SOFTWARE.
 */
 
 #include "aparse_list.h"
+#include "aparse_alloc.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -40,6 +41,7 @@ int aparse_list_new(
     list->size = 0;
     list->ptr = NULL;
     list->capacity = 0;
+    list->allocator = NULL;
     return init_size > 0 ? aparse_list_resize(list, init_size) : 1;
 }
 
@@ -52,14 +54,16 @@ int aparse_list_resize(
 
     if (new_size) 
     {
-        void* tmp = realloc(list->ptr, new_size * list->itemsz);
+        void* tmp = aparse_allocator_realloc(list->allocator, list->ptr, 
+                list->capacity * list->itemsz, new_size * list->itemsz);
         if (!tmp) 
             return 0;
         list->ptr = tmp;
         list->capacity = new_size;
         list->size = min(list->size, new_size);
     } else {
-        free(list->ptr);
+        aparse_allocator_free(list->allocator, list->ptr, 
+                list->capacity * list->itemsz);
         list->ptr = NULL;
         list->capacity = 0;
         list->size = 0;
@@ -90,6 +94,7 @@ void aparse_list_free(aparse_list* list)
 {
     if(!list)
         return;
-    free(list->ptr);
+    aparse_allocator_free(list->allocator, list->ptr, 
+            list->capacity * list->itemsz);
     memset(list, 0, sizeof(*list));
 }